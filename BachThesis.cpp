@@ -11,6 +11,7 @@
 #include <deque>
 #include <algorithm>
 #include <numeric>
+#include <optional>
 
 using namespace std;
 
@@ -18,8 +19,9 @@ inline bool checkErrorOrRecreate(vk::Result result, IContext& context) {
     if (result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR) {
         const auto capabilities = context.physicalDevice.getSurfaceCapabilitiesKHR(context.surface);
         context.currentExtent = capabilities.currentExtent;
-        recreateSwapchain(context);
+        // Other frames in flight may still render into the old swapchain
         context.device.waitIdle();
+        recreateSwapchain(context);
         recreatePipeline(context);
         return true;
     }
@@ -74,6 +76,15 @@ int main()
         std::cerr << "Device or queue not supported!" << std::endl;
         return -1;
     }
+    // Uploads use a transfer only family when there is one, so they run beside the rendering
+    icontext.transferFamilyIndex = icontext.primaryFamilyIndex;
+    for (uint32_t familyIndex = 0; familyIndex < icontext.queueFamilyProperties.size(); familyIndex++) {
+        const auto queueFlags = icontext.queueFamilyProperties[familyIndex].queueFlags;
+        if ((queueFlags & vk::QueueFlagBits::eTransfer) && !(queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            icontext.transferFamilyIndex = familyIndex;
+            break;
+        }
+    }
 
     const auto extensionsPresent = icontext.physicalDevice.enumerateDeviceExtensionProperties();
     for (auto value : extensionsPresent)
@@ -85,22 +96,36 @@ int main()
         }
     }
     const std::array queuePriorities{ 1.0f };
-    const vk::DeviceQueueCreateInfo queueCreateInfo({}, icontext.primaryFamilyIndex, queuePriorities);
+    std::vector queueCreateInfos = { vk::DeviceQueueCreateInfo({}, icontext.primaryFamilyIndex, queuePriorities) };
+    if (icontext.transferFamilyIndex != icontext.primaryFamilyIndex)
+        queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags(), icontext.transferFamilyIndex, queuePriorities);
 
     std::vector extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     vk::PhysicalDeviceFeatures2 features;
+    vk::PhysicalDeviceVulkan12Features vulkan12Features;
+    vulkan12Features.timelineSemaphore = true;
+    // Models are packed into one buffer and reached through device addresses whenever the device supports it
+    const auto supportedFeatures = icontext.physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    icontext.packedModels = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().bufferDeviceAddress;
+    vulkan12Features.bufferDeviceAddress = icontext.packedModels;
+    const auto limits = icontext.physicalDevice.getProperties().limits;
+    icontext.storageAlignment = limits.minStorageBufferOffsetAlignment;
+    icontext.timestampPeriod = limits.timestampComputeAndGraphics ? limits.timestampPeriod : 0.0f;
+    features.pNext = &vulkan12Features;
     vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
     if (icontext.meshShader) {
         extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
         meshShaderFeatures.meshShader = true;
         meshShaderFeatures.taskShader = true;
-        features.pNext = &meshShaderFeatures;
+        vulkan12Features.pNext = &meshShaderFeatures;
     }
 
     features.features.fillModeNonSolid = true;
-    const vk::DeviceCreateInfo deviceCreateInfo({}, queueCreateInfo, {}, extensions, {}, &features);
+    const vk::DeviceCreateInfo deviceCreateInfo({}, queueCreateInfos, {}, extensions, {}, &features);
     icontext.device = icontext.physicalDevice.createDevice(deviceCreateInfo);
     const ScopeExit cleanDevice([&]() { icontext.device.destroy(); });
+    createMemoryAllocator(icontext);
+    const ScopeExit cleanMemory([&]() { destroyMemoryAllocator(icontext); });
 
     if (icontext.meshShader) {
         icontext.dynamicLoader.vkCmdDrawMeshTasksEXT =
@@ -142,12 +167,8 @@ int main()
     createBuffer(icontext);
     const ScopeExit cleanBuffers([&]() { destroyBuffer(icontext); });
 
-    const auto waitSemaphore = icontext.device.createSemaphore({});
-    auto acquireSemaphore = icontext.device.createSemaphore({});
-    const ScopeExit cleanupSemaphore([&]() {
-        icontext.device.destroy(waitSemaphore);
-        icontext.device.destroy(acquireSemaphore);
-        });
+    createUploadManager(icontext);
+    const ScopeExit cleanUploadManager([&]() { destroyUploadManager(icontext); });
 
     vk::DescriptorPoolSize pool_sizes[] = {
         { vk::DescriptorType::eSampler, 1000},
@@ -190,44 +211,43 @@ int main()
     vulkanImguiInfo.MSAASamples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
     ImGui_ImplVulkan_Init(&vulkanImguiInfo);
 
-    std::vector<vk::Fence> fencesToCheck(icontext.amountOfImages);
-    for (auto& fence : fencesToCheck)
-    {
-        fence = icontext.device.createFence({});
-    }
-    const ScopeExit cleanFences([&]() { for (auto fence : fencesToCheck) icontext.device.destroy(fence); });
-
     const auto startTimeLoading = std::chrono::steady_clock::now();
     std::vector vtkNames = { "perf.vtk", "crystal.vtk", "cube.vtk", "bunny.vtk", "edge.vtk", "point.vtk",
-        "Armadillo.vtk"
+        "Armadillo.vtk", "bunny.tet"
     };
-    std::vector<VTKFile> loadedVtkFiles = { };
+    std::vector<std::string> vtkPaths;
     for (const auto& value : vtkNames) {
-        loadedVtkFiles.push_back(loadVTK(std::string("assets/") + value, icontext));
+        vtkPaths.push_back(std::string("assets/") + value);
     }
-    std::vector<VTKFile> vtkFiles = { loadedVtkFiles[0] };
+    // Models are added while the render loop already runs, an entry stays empty until its upload finished
+    std::vector<std::optional<VTKFile>> loadedVtkFiles(vtkNames.size());
+    const ScopeExit cleanCrystal([&]() { for (auto& file : loadedVtkFiles) if (file) file->unload(icontext); });
+    ModelLoader modelLoader(icontext, vtkPaths);
+    std::vector<VTKFile> vtkFiles;
     std::vector<char>& active = icontext.settings.activeModels;
     icontext.settings.activeModels.resize(vtkNames.size());
     active[0] = true;
-    const ScopeExit cleanCrystal([&]() { for (auto& file : loadedVtkFiles) file.unload(icontext); });
-    const auto endTimeLoading = std::chrono::steady_clock::now();
-    const auto durationLoading = std::chrono::duration_cast<std::chrono::nanoseconds>(endTimeLoading - startTimeLoading);
-    std::cout << "Loading time " << durationLoading.count() / (1e6f) << std::endl;
+    bool firstFrame = true;
 
     int64_t currentValue = 0;
+    int64_t waitValue = 0;
+    float sortValue = 0.0f;
+    // Edited by the slider, applied once it is released
+    int layerRounds = icontext.settings.layerRounds;
     std::deque<float> smoothing;
     constexpr size_t MAX_SMOOTH = 1000;
 
     const auto updateVTKs = [&]() {
         vtkFiles.clear();
         for (size_t i = 0; i < vtkNames.size(); i++) {
-            if (active[i]) {
-                vtkFiles.push_back(loadedVtkFiles[i]);
+            if (active[i] && loadedVtkFiles[i]) {
+                vtkFiles.push_back(*loadedVtkFiles[i]);
             }
         }
     };
 
     auto dTime = std::chrono::steady_clock::now();
+    auto lastFrame = dTime;
     while (!glfwWindowShouldClose(icontext.window))
     {
         const auto current = std::chrono::steady_clock::now();
@@ -235,28 +255,48 @@ int main()
         const auto deltaTime = durationOfFrame.count() * 1e-9f;
         dTime = current;
         glfwPollEvents();
+        if (!modelLoader.finished()) {
+            for (const auto& [index, file] : modelLoader.poll()) {
+                loadedVtkFiles[index] = file;
+                updateVTKs();
+            }
+            if (modelLoader.finished()) {
+                const auto durationLoading = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeLoading);
+                std::cout << "Loading time " << durationLoading.count() / (1e6f) << " ms (all models)" << std::endl;
+            }
+        }
         if (glfwGetWindowAttrib(icontext.window, GLFW_ICONIFIED)) {
             continue;
         }
         int x, y;
         glfwGetWindowSize(icontext.window, (int*)&x, (int*)&y);
         if (icontext.currentExtent.width != x || icontext.currentExtent.height != y) {
+            icontext.device.waitIdle();
             recreateSwapchain(icontext);
         }
 
-        const auto nextImage = icontext.device.acquireNextImageKHR(icontext.swapchain, std::numeric_limits<uint64_t>().max(), acquireSemaphore);
+        // Only the slot about to be reused has to be finished, the other frames keep the GPU busy meanwhile
+        auto& frame = icontext.commandBuffer.frames[icontext.currentFrame];
+        const auto startWait = std::chrono::steady_clock::now();
+        checkErrorOrRecreate(icontext.device.waitForFences(frame.fence, true, std::numeric_limits<uint64_t>().max()), icontext);
+        waitValue = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startWait).count();
+        if (const auto sortTime = readSortTime(icontext, frame))
+            sortValue = *sortTime;
+
+        const auto nextImage = icontext.device.acquireNextImageKHR(icontext.swapchain, std::numeric_limits<uint64_t>().max(), frame.acquire);
         if (checkErrorOrRecreate(nextImage.result, icontext)) {
-            icontext.device.destroy(acquireSemaphore);
-            acquireSemaphore = icontext.device.createSemaphore({});
+            icontext.device.destroy(frame.acquire);
+            frame.acquire = icontext.device.createSemaphore({});
             continue;
         }
+        icontext.device.resetFences(frame.fence);
 
         if (icontext.settings.animate) {
             const auto addition = icontext.settings.speed * deltaTime * 10.0f;
             const auto addedValue = icontext.settings.currentLOD + addition;
             icontext.settings.currentLOD = std::max(std::min(addedValue, 6.9f), 0.0f);
         }
-        updateCamera(icontext);
+        updateCamera(icontext, icontext.currentFrame);
 
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -298,10 +338,20 @@ int main()
             const auto sum = std::accumulate(smoothing.begin(), smoothing.end(), 0.0f);
             ImGui::Text("Frametime smoothed: %.3f ms", sum / (1e6f * smoothing.size()));
             ImGui::Text("Frametime: %.3f ms", currentValue / (1e6f));
+            ImGui::Text("Waiting for frame slot: %.3f ms", waitValue / (1e6f));
+            int framesInFlight = (int)icontext.framesInFlight;
+            if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, (int)MAX_FRAMES_IN_FLIGHT))
+                icontext.framesInFlight = (uint32_t)framesInFlight;
+            const auto memoryStatistics = icontext.memory.currentStatistics();
+            ImGui::Text("GPU memory: %.1f of %.1f MiB used, %zu allocations in %zu blocks", memoryStatistics.usedBytes / (1024.0f * 1024.0f),
+                memoryStatistics.reservedBytes / (1024.0f * 1024.0f), memoryStatistics.subAllocations, memoryStatistics.deviceAllocations);
             if (ImGui::CollapsingHeader("Models")) {
                 for (size_t i = 0; i < vtkNames.size(); i++)
                 {
-                    if (ImGui::Checkbox(vtkNames[i], (bool*)&active[i])) {
+                    if (!loadedVtkFiles[i]) {
+                        ImGui::TextDisabled("%s (%s)", vtkNames[i], modelLoader.failed[i] ? "failed" : "loading");
+                    }
+                    else if (ImGui::Checkbox(vtkNames[i], (bool*)&active[i])) {
                         updateVTKs();
                     }
                 }
@@ -317,8 +367,8 @@ int main()
                 if (ImGui::Button("Centre")) {
                     AABB aabb{};
                     for (size_t i = 0; i < vtkNames.size(); i++) {
-                        if (active[i]) {
-                            aabb = extendAABB(aabb, loadedVtkFiles[i].aabb);
+                        if (active[i] && loadedVtkFiles[i]) {
+                            aabb = extendAABB(aabb, loadedVtkFiles[i]->aabb);
                         }
                     }
                     const auto middle = (aabb.max + aabb.min) * 0.5f;
@@ -332,26 +382,69 @@ int main()
                 ImGui::SliderFloat("Speed", &icontext.settings.speed, -0.1f, 0.1f);
             }
             ImGui::Checkbox("Sort primitives", &icontext.settings.sortingOfPrimitives);
+            const auto currentSort = std::to_string(icontext.settings.sortType);
+            if (ImGui::BeginCombo("Sort mode", currentSort.c_str())) {
+                for (size_t i = 0; i < SORT_TYPE_AMOUNT; i++)
+                {
+                    const auto currentType = (SortType)i;
+                    if (needsPackedModels(currentType) && !icontext.packedModels) continue;
+                    const auto name = std::to_string(currentType);
+                    const bool isSelected = (icontext.settings.sortType == currentType);
+                    if (ImGui::Selectable(name.c_str(), isSelected))
+                        icontext.settings.sortType = currentType;
+                    if (isSelected) ImGui::SetItemDefaultFocus();
+                }
+                ImGui::EndCombo();
+            }
+            if (icontext.settings.sortType == SortType::FaceLayers) {
+                // Every value records its own layer sort, the one of the old value is freed
+                ImGui::SliderInt("Layer rounds", &layerRounds, 1, 4096);
+                if (ImGui::IsItemDeactivatedAfterEdit() && layerRounds != icontext.settings.layerRounds) {
+                    icontext.device.waitIdle();
+                    icontext.settings.layerRounds = layerRounds;
+                    evictLayerSorts(icontext, (uint32_t)layerRounds);
+                }
+            }
+            ImGui::Checkbox("Incremental sort", &icontext.settings.incrementalSort);
+            if (icontext.settings.incrementalSort) {
+                ImGui::SliderInt("Refine passes", &icontext.settings.refinePasses, 1, 8);
+                ImGui::SliderAngle("Full sort angle", &icontext.settings.fullSortAngle, 0.0f, 90.0f);
+                if (ImGui::Button("Full sort"))
+                    icontext.sortState.valid = false;
+                if (icontext.settings.sortingOfPrimitives)
+                    ImGui::Text("Sort pass: %s", std::to_string(icontext.sortState.lastPass).c_str());
+            }
+            if (icontext.settings.sortingOfPrimitives && icontext.timestampPeriod > 0.0f)
+                ImGui::Text("Sort time: %.3f ms", sortValue / (1e6f));
+            if (icontext.settings.sortingOfPrimitives && icontext.settings.sortType == SortType::FaceGraph)
+                ImGui::Text("Order time (CPU): %.3f ms, %zu cycles broken", icontext.sortState.orderTime / (1e6f), icontext.sortState.cycleBreaks);
         }
         ImGui::End();
         ImGui::Render();
 
-        rerecordPrimary(icontext, nextImage.value, vtkFiles);
-        const auto startTime = std::chrono::steady_clock::now();
+        const bool faceGraph = icontext.settings.sortingOfPrimitives && icontext.settings.sortType == SortType::FaceGraph;
+        if (updateVisibilityMeshes(icontext, loadedVtkFiles, faceGraph))
+            updateVTKs();
+        rerecordPrimary(icontext, icontext.currentFrame, nextImage.value, vtkFiles);
+        const auto renderFinished = icontext.commandBuffer.renderFinished[nextImage.value];
         const auto shaderStage = icontext.meshShader ? vk::PipelineStageFlagBits::eMeshShaderEXT : vk::PipelineStageFlagBits::eTopOfPipe;
         const std::array pipelineFlagBits = { vk::PipelineStageFlagBits::eAllGraphics | shaderStage };
-        const vk::SubmitInfo submitInfo(acquireSemaphore, pipelineFlagBits, icontext.commandBuffer.primaryBuffers[nextImage.value], waitSemaphore);
-        icontext.primaryQueue.submit(submitInfo, fencesToCheck[nextImage.value]);
+        const vk::SubmitInfo submitInfo(frame.acquire, pipelineFlagBits, frame.primary, renderFinished);
+        icontext.primaryQueue.submit(submitInfo, frame.fence);
 
-        const vk::PresentInfoKHR presentInfo(waitSemaphore, icontext.swapchain, nextImage.value);
+        const vk::PresentInfoKHR presentInfo(renderFinished, icontext.swapchain, nextImage.value);
         checkErrorOrRecreate((vk::Result)vkQueuePresentKHR((VkQueue)icontext.primaryQueue, (VkPresentInfoKHR*)&presentInfo), icontext);
+        if (firstFrame) {
+            firstFrame = false;
+            const auto durationFirstFrame = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeLoading);
+            std::cout << "Time to first frame " << durationFirstFrame.count() / (1e6f) << " ms" << std::endl;
+        }
+        icontext.currentFrame = (icontext.currentFrame + 1) % icontext.framesInFlight;
 
-        checkErrorOrRecreate(icontext.device.waitForFences(fencesToCheck[nextImage.value], true, std::numeric_limits<uint64_t>().max()), icontext);
-        icontext.device.resetFences(fencesToCheck[nextImage.value]);
-
+        // Time between two submitted frames, CPU and GPU work of different frames overlap
         const auto afterTime = std::chrono::steady_clock::now();
-        const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(afterTime - startTime);
-        currentValue = duration.count();
+        currentValue = std::chrono::duration_cast<std::chrono::nanoseconds>(afterTime - lastFrame).count();
+        lastFrame = afterTime;
         smoothing.push_back(currentValue);
         if (smoothing.size() > MAX_SMOOTH)
             smoothing.pop_front();
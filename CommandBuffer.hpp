@@ -12,9 +12,28 @@ inline void createPrimaryCommandBufferContext(IContext& context) {
         context.primaryFamilyIndex);
     context.commandBuffer.primaryPool = context.device.createCommandPool(defaultPoolCreateInfo);
     context.commandBuffer.uploadAndDataPool = context.device.createCommandPool(defaultPoolCreateInfo);
-
-    vk::CommandBufferAllocateInfo allocateInfo(context.commandBuffer.primaryPool, vk::CommandBufferLevel::ePrimary, context.amountOfImages);
-    context.commandBuffer.primaryBuffers = context.device.allocateCommandBuffers(allocateInfo);
+    context.commandBuffer.cachePool = context.device.createCommandPool(vk::CommandPoolCreateInfo({}, context.primaryFamilyIndex));
+
+    vk::CommandBufferAllocateInfo allocateInfo(context.commandBuffer.primaryPool, vk::CommandBufferLevel::ePrimary, MAX_FRAMES_IN_FLIGHT);
+    const auto primaryBuffers = context.device.allocateCommandBuffers(allocateInfo);
+    allocateInfo.level = vk::CommandBufferLevel::eSecondary;
+    const auto imguiBuffers = context.device.allocateCommandBuffers(allocateInfo);
+    allocateInfo.level = vk::CommandBufferLevel::ePrimary;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        auto& frame = context.commandBuffer.frames[i];
+        frame.primary = primaryBuffers[i];
+        frame.imgui = imguiBuffers[i];
+        frame.acquire = context.device.createSemaphore({});
+        frame.fence = context.device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+        if (context.timestampPeriod > 0.0f)
+            frame.timestamps = context.device.createQueryPool(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 2));
+    }
+    context.commandBuffer.renderFinished.resize(context.amountOfImages);
+    for (auto& semaphore : context.commandBuffer.renderFinished)
+    {
+        semaphore = context.device.createSemaphore({});
+    }
     allocateInfo.commandBufferCount = context.commandBuffer.dataCommandBuffer.size();
     const auto dataBuffers = context.device.allocateCommandBuffers(allocateInfo);
     std::copy(dataBuffers.begin(), dataBuffers.end(), context.commandBuffer.dataCommandBuffer.begin());
@@ -28,10 +47,147 @@ inline void createPrimaryCommandBufferContext(IContext& context) {
 inline void destroyPrimaryCommandBufferContext(IContext& context) {
     context.device.destroy(context.commandBuffer.primaryPool);
     context.device.destroy(context.commandBuffer.uploadAndDataPool);
+    context.device.destroy(context.commandBuffer.cachePool);
     for (const auto fence : context.commandBuffer.dataCommandFences)
     {
         context.device.destroy(fence);
     }
+    for (const auto& frame : context.commandBuffer.frames)
+    {
+        context.device.destroy(frame.acquire);
+        context.device.destroy(frame.fence);
+        context.device.destroy(frame.timestamps);
+    }
+    for (const auto semaphore : context.commandBuffer.renderFinished)
+    {
+        context.device.destroy(semaphore);
+    }
+}
+
+inline void createMemoryAllocator(IContext& context) {
+    context.memory.device = context.device;
+    context.memory.deviceAddress = context.packedModels;
+    context.memory.properties = context.physicalDevice.getMemoryProperties();
+}
+
+// Every allocation has to be released before, blocks still alive are freed anyway
+inline void destroyMemoryAllocator(IContext& context) {
+    const auto statistics = context.memory.currentStatistics();
+    if (statistics.subAllocations != 0)
+        std::cout << "Warning: " << statistics.subAllocations << " memory allocations were not released" << std::endl;
+    context.memory.destroy();
+}
+
+inline void createUploadManager(IContext& context, vk::DeviceSize ringSize = 64ull << 20) {
+    auto& upload = context.upload;
+    upload.queue = context.device.getQueue(context.transferFamilyIndex, 0);
+    const vk::CommandPoolCreateInfo uploadPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        context.transferFamilyIndex);
+    upload.pool = context.device.createCommandPool(uploadPoolCreateInfo);
+
+    const vk::BufferCreateInfo stagingBufferCreateInfo({}, ringSize, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::SharingMode::eExclusive, context.transferFamilyIndex);
+    upload.stagingBuffer = context.device.createBuffer(stagingBufferCreateInfo);
+    const auto requirements = context.device.getBufferMemoryRequirements(upload.stagingBuffer);
+    upload.stagingMemory = context.requestMemory(requirements,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryStrategy::Linear);
+    context.device.bindBufferMemory(upload.stagingBuffer, upload.stagingMemory.memory, upload.stagingMemory.offset);
+    upload.mapped = upload.stagingMemory.mapped;
+    upload.ringSize = ringSize;
+
+    vk::SemaphoreTypeCreateInfo timelineCreateInfo(vk::SemaphoreType::eTimeline, 0);
+    vk::SemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.setPNext(&timelineCreateInfo);
+    upload.timeline = context.device.createSemaphore(semaphoreCreateInfo);
+}
+
+inline void destroyUploadManager(IContext& context) {
+    auto& upload = context.upload;
+    flushUploads(context);
+    while (!upload.inFlight.empty())
+        reclaimUploads(context, true);
+    context.device.destroy(upload.timeline);
+    context.device.destroy(upload.stagingBuffer);
+    context.releaseMemory(upload.stagingMemory);
+    context.device.destroy(upload.pool);
+}
+
+struct CameraInfo {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 whole;
+    glm::mat4 inverse;
+    glm::vec4 colorADepth;
+    float lod;
+    uint32_t type;
+};
+
+constexpr float INTERNAL_PI = 3.14159265358979323846  /* pi */;
+
+inline glm::vec3 cameraEye(const ContextSetting& settings) {
+    float yaw = settings.rotationAndZoom.x;
+    float pitch = settings.rotationAndZoom.y - INTERNAL_PI*0.5;
+    glm::vec3 lookAt;
+    lookAt.x = std::cos(yaw) * std::cos(pitch);
+    lookAt.y = std::sin(pitch);
+    lookAt.z = std::sin(yaw) * std::cos(pitch);
+    lookAt = glm::normalize(lookAt);
+    lookAt *= settings.rotationAndZoom.z;
+    return settings.position + lookAt;
+}
+
+// Only writes the slot of this frame in the mapped staging buffer, recordCameraCopy moves it into the uniform buffer
+inline void updateCamera(IContext & context, uint32_t slot) {
+    CameraInfo* cameraMap = (CameraInfo*)context.cameraStagingMemory.mapped + slot;
+    const float aspect = context.currentExtent.width / (float)context.currentExtent.height;
+    auto projectionMatrix = glm::perspective(context.settings.FOV, aspect, context.settings.planes.x, context.settings.planes.y);
+    projectionMatrix[1][1] *= -1;
+    cameraMap->proj = projectionMatrix;
+
+    cameraMap->view = glm::lookAt(cameraEye(context.settings), context.settings.position, glm::vec3{ 0.0f, 1.0f, 0.0f });
+    cameraMap->model = glm::identity<glm::mat4>();
+    cameraMap->whole = projectionMatrix * cameraMap->view * cameraMap->model;
+    cameraMap->inverse = glm::inverse(projectionMatrix * cameraMap->view);
+    cameraMap->colorADepth = context.settings.colorADepth;
+    const auto values = ((uint32_t)context.settings.currentLOD);
+    cameraMap->lod = context.settings.currentLOD - values;
+    cameraMap->type = (context.oldLOD < values ? 1 : 0);
+    if (cameraMap->type == 0) {
+        const auto oldValues = ((uint32_t)context.oldLOD);
+        cameraMap->type = (context.settings.currentLOD < oldValues ? 2 : 0);
+    }
+    context.oldLOD = context.settings.currentLOD;
+    context.changedLOD = cameraMap->type;
+#ifndef NDEBUG
+    if (context.changedLOD) {
+        assert(cameraMap->type == 1 || cameraMap->type == 2);
+        if (cameraMap->type == 1) std::cout << "Changed LOD Level up" << std::endl;
+        else std::cout << "Changed LOD Level down" << std::endl;
+    }
+#endif // !NDEBUG
+}
+
+inline vk::PipelineStageFlags shaderStages(const IContext& context) {
+    return vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader |
+        vk::PipelineStageFlagBits::eFragmentShader | (context.meshShader ?
+        vk::PipelineStageFlagBits::eTaskShaderEXT | vk::PipelineStageFlagBits::eMeshShaderEXT : vk::PipelineStageFlags{});
+}
+
+// Recorded at the start of every primary buffer, the barriers keep the reads of the previous frame
+// before the copy and every read of this frame after it. As frames overlap, the first one also makes the
+// shader writes of the previous frame (LOD, sorting) visible to this one
+inline void recordCameraCopy(IContext& context, vk::CommandBuffer commandBuffer, uint32_t slot) {
+    const auto readStages = shaderStages(context);
+    const vk::MemoryBarrier previousFrame(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    const vk::BufferMemoryBarrier beforeCopy(vk::AccessFlagBits::eUniformRead, vk::AccessFlagBits::eTransferWrite,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, context.uniformCamera, 0, VK_WHOLE_SIZE);
+    commandBuffer.pipelineBarrier(readStages, vk::PipelineStageFlagBits::eTransfer | readStages, {}, previousFrame, beforeCopy, {});
+    const vk::BufferCopy bufferCopy(slot * sizeof(CameraInfo), 0, sizeof(CameraInfo));
+    commandBuffer.copyBuffer(context.stagingCamera, context.uniformCamera, bufferCopy);
+    const vk::BufferMemoryBarrier afterCopy(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eUniformRead,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, context.uniformCamera, 0, VK_WHOLE_SIZE);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, readStages, {}, {}, afterCopy, {});
 }
 
 inline void recordMeshPipeline(const VTKFile& vtk, vk::CommandBuffer currentBuffer, IContext& context) {
@@ -39,68 +195,443 @@ inline void recordMeshPipeline(const VTKFile& vtk, vk::CommandBuffer currentBuff
 }
 
 inline void recordVertexPipeline(const VTKFile& vtk, vk::CommandBuffer currentBuffer, IContext& context) {
-    const uint32_t currentOffset = 0;
-    currentBuffer.pushConstants(context.defaultPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32_t), &currentOffset);
     currentBuffer.draw(vtk.amountOfTetrahedrons * 12, 1, 0, 0);
 }
 
-inline void rerecordPrimary(IContext& context, uint32_t currentImage, const std::vector<VTKFile>& vtkFiles) {
-    auto& currentBuffer = context.commandBuffer.primaryBuffers[currentImage];
+// Cached buffers can be pending in every frame in flight at once
+inline vk::CommandBuffer beginCachedSecondary(IContext& context, const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+    vk::CommandBufferUsageFlags flags = {}) {
+    const vk::CommandBufferAllocateInfo allocateInfo(context.commandBuffer.cachePool, vk::CommandBufferLevel::eSecondary, 1);
+    const auto buffer = context.device.allocateCommandBuffers(allocateInfo)[0];
+    vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eSimultaneousUse | flags);
+    beginInfo.setPInheritanceInfo(&inheritanceInfo);
+    buffer.begin(beginInfo);
+    return buffer;
+}
+
+inline vk::CommandBuffer cachedLODCommands(IContext& context, const VTKFile& vtk, size_t lodToUse) {
+    const CommandBufferContext::CacheKey key{ vtk.data.buffer, (uint32_t)lodToUse, context.changedLOD };
+    const auto cached = context.commandBuffer.cachedLOD.find(key);
+    if (cached != context.commandBuffer.cachedLOD.end()) return cached->second;
+
+    const vk::CommandBufferInheritanceInfo inheritanceInfo;
+    const auto buffer = beginCachedSecondary(context, inheritanceInfo);
+    const size_t nextLOD = lodToUse + 1;
+    bindCamera(context, buffer, vk::PipelineBindPoint::eCompute);
+    const auto lodUpdateAmount = vtk.lodUpdateAmount[lodToUse];
+    if (context.changedLOD && lodUpdateAmount != 0) {
+        const auto level = (context.changedLOD == 1 ? lodToUse : nextLOD) - 1;
+        bindModel(context, buffer, vk::PipelineBindPoint::eCompute, vtk.data, vtk.descriptor, level);
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLODUpdatePipeline);
+        buffer.dispatch(lodUpdateAmount, 1, 1);
+    }
+    const auto lodAmount = vtk.lodAmount[lodToUse];
+    if (lodAmount != 0) {
+        bindModel(context, buffer, vk::PipelineBindPoint::eCompute, vtk.data, vtk.descriptor, nextLOD - 1);
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLODPipeline);
+        buffer.dispatch(lodAmount, 1, 1);
+    }
+    buffer.end();
+    context.commandBuffer.cachedLOD.emplace(key, buffer);
+    return buffer;
+}
+
+inline vk::CommandBuffer cachedDrawCommands(IContext& context, const VTKFile& vtk, size_t lodToUse) {
+    const CommandBufferContext::CacheKey key{ vtk.data.buffer, (uint32_t)context.settings.type, (uint32_t)lodToUse };
+    const auto cached = context.commandBuffer.cachedDraws.find(key);
+    if (cached != context.commandBuffer.cachedDraws.end()) return cached->second;
+
+    const vk::CommandBufferInheritanceInfo inheritanceInfo(context.renderPass, 0);
+    const auto buffer = beginCachedSecondary(context, inheritanceInfo, vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+    buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getFromType(context.settings.type, context));
+    bindCamera(context, buffer, vk::PipelineBindPoint::eGraphics);
+    bindModel(context, buffer, vk::PipelineBindPoint::eGraphics, vtk.data, vtk.descriptor, lodToUse - 1);
+    if (context.meshShader) {
+        recordMeshPipeline(vtk, buffer, context);
+    }
+    else {
+        recordVertexPipeline(vtk, buffer, context);
+    }
+    buffer.end();
+    context.commandBuffer.cachedDraws.emplace(key, buffer);
+    return buffer;
+}
+
+// The cached buffers reference the pipelines, only call while the device is idle
+inline void clearCommandCache(IContext& context) {
+    auto& commandBuffer = context.commandBuffer;
+    std::vector<vk::CommandBuffer> buffers;
+    for (const auto& cache : { &commandBuffer.cachedDraws, &commandBuffer.cachedLOD, &commandBuffer.cachedSorts, &commandBuffer.cachedRefines,
+        &commandBuffer.cachedProjections })
+        for (const auto& [key, buffer] : *cache)
+            buffers.push_back(buffer);
+    if (!buffers.empty())
+        context.device.freeCommandBuffers(commandBuffer.cachePool, buffers);
+    commandBuffer.cachedDraws.clear();
+    commandBuffer.cachedLOD.clear();
+    commandBuffer.cachedSorts.clear();
+    commandBuffer.cachedRefines.clear();
+    commandBuffer.cachedProjections.clear();
+}
+
+// Frees the layer sorts recorded for other layer rounds, only call while the device is idle
+inline void evictLayerSorts(IContext& context, uint32_t rounds) {
+    auto& cachedSorts = context.commandBuffer.cachedSorts;
+    std::vector<vk::CommandBuffer> buffers;
+    std::erase_if(cachedSorts, [&](const auto& entry) {
+        const auto& [key, buffer] = entry;
+        if (std::get<1>(key) != (uint32_t)SortType::FaceLayers || std::get<2>(key) == rounds) return false;
+        buffers.push_back(buffer);
+        return true;
+        });
+    if (!buffers.empty())
+        context.device.freeCommandBuffers(context.commandBuffer.cachePool, buffers);
+}
+
+inline void destroyRadixScratch(IContext& context) {
+    auto& scratch = context.radixScratch;
+    if (!scratch.buffer) return;
+    context.device.destroy(scratch.buffer);
+    context.releaseMemory(scratch.memory);
+    scratch = RadixScratch{};
+}
+
+// Grows the sort scratch to hold amount elements. Waits for the device, the frames in flight
+// and the cached sorts still use the old buffer
+inline void ensureRadixScratch(IContext& context, size_t amount) {
+    auto& scratch = context.radixScratch;
+    if (amount <= scratch.capacity) return;
+    context.device.waitIdle();
+    clearCommandCache(context);
+    destroyRadixScratch(context);
+
+    // histogram, tile counters, look-back states, keys twice and the second value array
+    scratch.capacity = findPowerAbove((uint32_t)amount);
+    const vk::DeviceSize tiles = (scratch.capacity + RADIX_TILE - 1) / RADIX_TILE;
+    const vk::DeviceSize arraySize = scratch.capacity * sizeof(uint32_t);
+    const std::array<vk::DeviceSize, 6> sizes = { RADIX_PASSES * 256 * sizeof(uint32_t), RADIX_PASSES * sizeof(uint32_t),
+        tiles * 256 * sizeof(uint32_t), arraySize, arraySize, arraySize };
+    std::array<vk::DeviceSize, 6> offsets;
+    std::array<vk::DeviceAddress, 6> header;
+    vk::DeviceSize size = sizeof(header);
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        offsets[i] = (size + 15) / 16 * 16;
+        size = offsets[i] + sizes[i];
+    }
+    scratch.countersOffset = offsets[0];
+    scratch.countersSize = offsets[1] + sizes[1] - offsets[0];
+    scratch.statusOffset = offsets[2];
+    scratch.statusSize = sizes[2];
+
+    // The layer sort dispatches indirectly from the start of the histograms
+    const vk::BufferCreateInfo bufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer
+        | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eIndirectBuffer, vk::SharingMode::eExclusive, context.primaryFamilyIndex);
+    scratch.buffer = context.device.createBuffer(bufferCreateInfo);
+    scratch.memory = context.requestMemory(context.device.getBufferMemoryRequirements(scratch.buffer), vk::MemoryPropertyFlagBits::eDeviceLocal);
+    context.device.bindBufferMemory(scratch.buffer, scratch.memory.memory, scratch.memory.offset);
+    scratch.address = context.device.getBufferAddress(vk::BufferDeviceAddressInfo(scratch.buffer));
+    for (size_t i = 0; i < header.size(); i++)
+        header[i] = scratch.address + offsets[i];
+
+    const auto [buffer, fence] = context.commandBuffer.get<DataCommandBuffer::DataUpload>();
+    buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    buffer.updateBuffer(scratch.buffer, 0, sizeof(header), header.data());
+    buffer.end();
+    std::array buffers = { buffer };
+    vk::SubmitInfo submitInfo({}, {}, buffers, {});
+    context.primaryQueue.submit(submitInfo, fence);
+    const auto result = context.device.waitForFences(fence, true, std::numeric_limits<uint64_t>().max());
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("Wait for fence failed!");
+    context.device.resetFences(fence);
+}
+
+// Same test as cull.comp: false once all eight corners are outside the same clip plane. The LOD only
+// collapses tetrahedrons into their barycentres, so the bounds of the source mesh hold on every level
+inline bool boundsVisible(const AABB& aabb, const glm::mat4& whole) {
+    uint32_t outside = 0x3Fu;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        const glm::vec3 corner((i & 1) ? aabb.max.x : aabb.min.x, (i & 2) ? aabb.max.y : aabb.min.y, (i & 4) ? aabb.max.z : aabb.min.z);
+        const auto clip = whole * glm::vec4(corner, 1.0f);
+        uint32_t planes = 0;
+        planes |= clip.x < -clip.w ? 1u : 0u;
+        planes |= clip.x > clip.w ? 2u : 0u;
+        planes |= clip.y < -clip.w ? 4u : 0u;
+        planes |= clip.y > clip.w ? 8u : 0u;
+        planes |= clip.z < -clip.w ? 16u : 0u;
+        planes |= clip.z > clip.w ? 32u : 0u;
+        outside &= planes;
+    }
+    return outside == 0;
+}
+
+inline bool needsPackedModels(SortType type) {
+    return type == SortType::RadixCentroid || type == SortType::RadixFarthest || type == SortType::FaceLayers;
+}
+
+// Every sort type which needs packedModels runs in context.radixScratch
+inline bool scratchSorting(const IContext& context) {
+    return context.packedModels && needsPackedModels(context.settings.sortType);
+}
+
+// Bitonic sorts use the secondary of the model, radix and layer sorts are cached per sort type and the layer
+// rounds. The face graph order is no secondary, the bitonic sort stands in for models without a CPU copy
+inline vk::CommandBuffer cachedSortCommands(IContext& context, const VTKFile& vtk) {
+    if (!scratchSorting(context)) return vtk.sortSecondary;
+    const auto type = context.settings.sortType;
+    const auto rounds = type == SortType::FaceLayers ? (uint32_t)context.settings.layerRounds : 0u;
+    const CommandBufferContext::CacheKey key{ vtk.data.buffer, (uint32_t)type, rounds };
+    const auto cached = context.commandBuffer.cachedSorts.find(key);
+    if (cached != context.commandBuffer.cachedSorts.end()) return cached->second;
+
+    const vk::CommandBufferInheritanceInfo inheritanceInfo;
+    const auto buffer = beginCachedSecondary(context, inheritanceInfo);
+    bindCamera(context, buffer, vk::PipelineBindPoint::eCompute);
+    bindModel(context, buffer, vk::PipelineBindPoint::eCompute, vtk.data, vtk.descriptor, 0);
+    if (type == SortType::FaceLayers)
+        recordLayerSort((uint32_t)vtk.amountOfTetrahedrons, buffer, context, rounds);
+    else
+        recordRadixSort((uint32_t)vtk.amountOfTetrahedrons, buffer, context, type);
+    buffer.end();
+    context.commandBuffer.cachedSorts.emplace(key, buffer);
+    return buffer;
+}
+
+inline vk::CommandBuffer cachedProjectionCommands(IContext& context, const VTKFile& vtk) {
+    const CommandBufferContext::CacheKey key{ vtk.data.buffer, 0, 0 };
+    const auto cached = context.commandBuffer.cachedProjections.find(key);
+    if (cached != context.commandBuffer.cachedProjections.end()) return cached->second;
+
+    const vk::CommandBufferInheritanceInfo inheritanceInfo;
+    const auto buffer = beginCachedSecondary(context, inheritanceInfo);
+    bindCamera(context, buffer, vk::PipelineBindPoint::eCompute);
+    bindModel(context, buffer, vk::PipelineBindPoint::eCompute, vtk.data, vtk.descriptor, 0);
+    recordProjection(vtk.data, buffer, context);
+    // Only the task shader reads the cluster visibility
+    if (context.meshShader)
+        recordClusterCulling(vtk.data, buffer, context);
+    buffer.end();
+    context.commandBuffer.cachedProjections.emplace(key, buffer);
+    return buffer;
+}
+
+inline vk::CommandBuffer cachedRefineCommands(IContext& context, const VTKFile& vtk, uint32_t passes) {
+    const CommandBufferContext::CacheKey key{ vtk.data.buffer, passes, 0 };
+    const auto cached = context.commandBuffer.cachedRefines.find(key);
+    if (cached != context.commandBuffer.cachedRefines.end()) return cached->second;
+
+    const vk::CommandBufferInheritanceInfo inheritanceInfo;
+    const auto buffer = beginCachedSecondary(context, inheritanceInfo);
+    bindCamera(context, buffer, vk::PipelineBindPoint::eCompute);
+    bindModel(context, buffer, vk::PipelineBindPoint::eCompute, vtk.data, vtk.descriptor, 0);
+    recordRefineSort((uint32_t)vtk.amountOfTetrahedrons, buffer, context, vtk.data.info(2), passes);
+    buffer.end();
+    context.commandBuffer.cachedRefines.emplace(key, buffer);
+    return buffer;
+}
+
+// Full sort on the first frame, after a reset or a change of models or sort type and once the eye moved further than
+// fullSortAngle (measured as distance over zoom) from the last full sort. Skipped while camera and LOD stay the same,
+// refined from the last order otherwise. Without incrementalSort every frame is sorted fully
+inline SortPass nextSortPass(IContext& context, const std::vector<VTKFile>& vtkFiles) {
+    auto& state = context.sortState;
+    const auto& settings = context.settings;
+    const auto& camera = *((CameraInfo*)context.cameraStagingMemory.mapped + context.currentFrame);
+    std::vector<vk::Buffer> models;
+    for (const auto& vtk : vtkFiles)
+        models.push_back(vtk.data.buffer);
+    const auto eye = cameraEye(settings);
+
+    SortPass pass = SortPass::Refine;
+    if (!settings.incrementalSort || !state.valid || state.type != settings.sortType || state.models != models ||
+        glm::distance(eye, state.eye) > settings.fullSortAngle * std::max(settings.rotationAndZoom.z, 1e-3f))
+        pass = SortPass::Full;
+    else if (state.whole == camera.whole && state.lod == settings.currentLOD)
+        pass = SortPass::Skipped;
+    // The face graph orders are exact, there is nothing to refine
+    if (pass == SortPass::Refine && (settings.sortType == SortType::FaceGraph || settings.sortType == SortType::FaceLayers))
+        pass = SortPass::Full;
+
+    if (pass == SortPass::Full) {
+        state.valid = true;
+        state.type = settings.sortType;
+        state.models = std::move(models);
+        state.eye = eye;
+    }
+    state.whole = camera.whole;
+    state.lod = settings.currentLOD;
+    state.lastPass = pass;
+    return pass;
+}
+
+inline void destroyOrderStaging(IContext& context, FrameData& frame) {
+    if (!frame.orderStaging) return;
+    context.device.destroy(frame.orderStaging);
+    context.releaseMemory(frame.orderStagingMemory);
+    frame.orderStaging = nullptr;
+    frame.orderStagingSize = 0;
+}
+
+// Only called after the fence of frame signaled, nothing else uses its staging buffer
+inline void ensureOrderStaging(IContext& context, FrameData& frame, vk::DeviceSize size) {
+    if (size <= frame.orderStagingSize) return;
+    destroyOrderStaging(context, frame);
+    const vk::BufferCreateInfo bufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, context.primaryFamilyIndex);
+    frame.orderStaging = context.device.createBuffer(bufferCreateInfo);
+    frame.orderStagingMemory = context.requestMemory(context.device.getBufferMemoryRequirements(frame.orderStaging),
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    context.device.bindBufferMemory(frame.orderStaging, frame.orderStagingMemory.memory, frame.orderStagingMemory.offset);
+    frame.orderStagingSize = size;
+}
+
+// Computes the face graph order of every model with a CPU copy into the staging buffer of frame and copies
+// it over the sort indices. Returns the models which have to be sorted on the GPU instead
+inline std::vector<const VTKFile*> recordFaceGraphOrder(IContext& context, FrameData& frame, vk::CommandBuffer commandBuffer,
+    const std::vector<VTKFile>& vtkFiles) {
+    std::vector<const VTKFile*> remaining;
+    vk::DeviceSize size = 0;
+    for (const auto& vtk : vtkFiles)
+        if (vtk.visibility) size += vtk.amountOfTetrahedrons * sizeof(TetIndex);
+        else remaining.push_back(&vtk);
+    if (size == 0) return remaining;
+    ensureOrderStaging(context, frame, size);
+
+    const auto startTimeOrder = std::chrono::steady_clock::now();
+    const auto eye = cameraEye(context.settings);
+    std::vector<vk::BufferMemoryBarrier> beforeCopy;
+    std::vector<std::pair<vk::Buffer, vk::BufferCopy>> copies;
+    vk::DeviceSize offset = 0;
+    context.sortState.cycleBreaks = 0;
+    for (const auto& vtk : vtkFiles)
+    {
+        if (!vtk.visibility) continue;
+        const auto order = vtk.visibility->update(eye);
+        context.sortState.cycleBreaks += vtk.visibility->stats.cycleBreaks;
+        std::memcpy(frame.orderStagingMemory.mapped + offset, order.data(), order.size_bytes());
+        const auto target = vtk.data.info(2);
+        beforeCopy.emplace_back(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferWrite,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, target.buffer, target.offset, order.size_bytes());
+        copies.emplace_back(target.buffer, vk::BufferCopy(offset, target.offset, order.size_bytes()));
+        offset += order.size_bytes();
+    }
+    context.sortState.orderTime = (float)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeOrder).count();
+
+    commandBuffer.pipelineBarrier(shaderStages(context), vk::PipelineStageFlagBits::eTransfer, {}, {}, beforeCopy, {});
+    for (const auto& [buffer, copy] : copies)
+        commandBuffer.copyBuffer(frame.orderStaging, buffer, copy);
+    auto afterCopy = beforeCopy;
+    for (auto& barrier : afterCopy) {
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    }
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, shaderStages(context), {}, {}, afterCopy, {});
+    return remaining;
+}
+
+// GPU time of the sorting in the last submit of this frame slot in ns, call after its fence signaled
+inline std::optional<float> readSortTime(IContext& context, const FrameData& frame) {
+    if (!frame.sortTimed) return std::nullopt;
+    const auto [result, ticks] = context.device.getQueryPoolResults<uint64_t>(frame.timestamps, 0, 2, 2 * sizeof(uint64_t),
+        sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) return std::nullopt;
+    return (ticks[1] - ticks[0]) * context.timestampPeriod;
+}
+
+// Stitches the cached secondaries together, only the camera copy and ImGui are recorded every frame
+inline void rerecordPrimary(IContext& context, uint32_t currentFrame, uint32_t currentImage, const std::vector<VTKFile>& vtkFiles) {
+    if (context.settings.sortingOfPrimitives && scratchSorting(context)) {
+        size_t largest = 0;
+        for (const auto& vtk : vtkFiles)
+            largest = std::max(largest, vtk.amountOfTetrahedrons);
+        ensureRadixScratch(context, largest);
+    }
+
+    auto& frame = context.commandBuffer.frames[currentFrame];
+    auto& currentBuffer = frame.primary;
     const vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     currentBuffer.begin(beginInfo);
+    recordCameraCopy(context, currentBuffer, currentFrame);
 
-    if (context.settings.sortingOfPrimitives) {
+    // The LOD changes the vertices, so it runs before the projection and the sort see them
+    std::vector<vk::CommandBuffer> secondaries;
+    const size_t lodToUse = context.settings.useLOD ? ((size_t)context.settings.currentLOD + 1u) : 1u;
+    if (context.settings.useLOD) {
         for (const auto& vtk : vtkFiles)
         {
-            currentBuffer.executeCommands(vtk.sortSecondary);
+            secondaries.push_back(cachedLODCommands(context, vtk, lodToUse));
         }
     }
-
-    const size_t lodToUse = context.settings.useLOD ? ((size_t)context.settings.currentLOD + 1u) : 1u;
-    if (context.settings.useLOD) {
-        const size_t nextLOD = lodToUse + 1;
+    if (!secondaries.empty())
+        currentBuffer.executeCommands(secondaries);
+    secondaries.clear();
+
+    frame.sortTimed = false;
+    const bool sorting = context.settings.sortingOfPrimitives && !vtkFiles.empty();
+    const auto pass = sorting ? nextSortPass(context, vtkFiles) : SortPass::Full;
+    if (sorting) {
+        // Skipped frames are timed as well, so the readout drops to zero for a static camera
+        frame.sortTimed = (bool)frame.timestamps;
+        if (frame.sortTimed) {
+            currentBuffer.resetQueryPool(frame.timestamps, 0, 2);
+            currentBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.timestamps, 0);
+        }
+    }
+    // Read by the bitonic sort and the task shader. A skipped sort means camera and LOD did not change, the cache still holds
+    if ((sorting || context.meshShader) && pass != SortPass::Skipped) {
         for (const auto& vtk : vtkFiles)
+            secondaries.push_back(cachedProjectionCommands(context, vtk));
+        if (!secondaries.empty())
+            currentBuffer.executeCommands(secondaries);
+        secondaries.clear();
+    }
+    if (sorting) {
+        std::vector<const VTKFile*> gpuSorted;
+        if (pass != SortPass::Skipped && context.settings.sortType == SortType::FaceGraph)
+            gpuSorted = recordFaceGraphOrder(context, frame, currentBuffer, vtkFiles);
+        else
+            for (const auto& vtk : vtkFiles)
+                gpuSorted.push_back(&vtk);
+        for (const auto vtk : gpuSorted)
         {
-            const auto lodUpdateAmount = vtk.lodUpdateAmount[lodToUse];
-            if (context.changedLOD && lodUpdateAmount != 0) {
-                const std::array descriptorsToUse = { vtk.descriptor[0], vtk.descriptor[context.changedLOD == 1 ? lodToUse : nextLOD] };
-                currentBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, context.defaultPipelineLayout, 0, descriptorsToUse, {});
-                currentBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLODUpdatePipeline);
-                currentBuffer.dispatch(lodUpdateAmount, 1, 1);
-            }
-            const auto lodAmount = vtk.lodAmount[lodToUse];
-            if (lodAmount == 0) continue;
-            const std::array descriptorsToUse = { vtk.descriptor[0], vtk.descriptor[nextLOD] };
-            currentBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, context.defaultPipelineLayout, 0, descriptorsToUse, {});
-            currentBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLODPipeline);
-            currentBuffer.dispatch(lodAmount, 1, 1);
+            if (pass == SortPass::Full)
+                secondaries.push_back(cachedSortCommands(context, *vtk));
+            else if (pass == SortPass::Refine)
+                secondaries.push_back(cachedRefineCommands(context, *vtk, (uint32_t)context.settings.refinePasses));
         }
+        if (!secondaries.empty())
+            currentBuffer.executeCommands(secondaries);
+        if (frame.sortTimed)
+            currentBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, frame.timestamps, 1);
+        secondaries.clear();
     }
 
-
     const vk::ClearColorValue whiteValue{ 1.0f, 1.0f, 1.0f, 1.0f };
     const vk::ClearColorValue blackValue{ 0.0f, 0.0f, 0.0f, 1.0f };
     const vk::ClearValue clearColor(context.settings.type == PipelineType::ProxyABuffer ? blackValue : whiteValue);
     const vk::RenderPassBeginInfo renderPassBegin(context.renderPass, context.frameBuffer[currentImage],
         { {0,0}, context.currentExtent }, clearColor);
-    currentBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
-
-    const vk::Pipeline currentPipeline = getFromType(context.settings.type, context);
-    currentBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, currentPipeline);
+    currentBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eSecondaryCommandBuffers);
 
+    // Models completely outside the view launch no draw at all
+    secondaries.clear();
+    const auto& camera = *((CameraInfo*)context.cameraStagingMemory.mapped + currentFrame);
     for (const auto& vtk : vtkFiles)
     {
-        const std::array descriptorsToUse = { vtk.descriptor[0], vtk.descriptor[lodToUse] };
-        currentBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, context.defaultPipelineLayout, 0, descriptorsToUse, {});
-        if (context.meshShader) {
-            recordMeshPipeline(vtk, currentBuffer, context);
-        }
-        else {
-            recordVertexPipeline(vtk, currentBuffer, context);
-        }
+        if (boundsVisible(vtk.aabb, camera.whole))
+            secondaries.push_back(cachedDrawCommands(context, vtk, lodToUse));
     }
 
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), currentBuffer);
+    const vk::CommandBufferInheritanceInfo inheritanceInfo(context.renderPass, 0, context.frameBuffer[currentImage]);
+    vk::CommandBufferBeginInfo imguiBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+    imguiBeginInfo.setPInheritanceInfo(&inheritanceInfo);
+    frame.imgui.begin(imguiBeginInfo);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), frame.imgui);
+    frame.imgui.end();
+    secondaries.push_back(frame.imgui);
+
+    currentBuffer.executeCommands(secondaries);
     currentBuffer.endRenderPass();
     currentBuffer.end();
 }
@@ -160,13 +691,21 @@ inline void renderPassCreation(IContext& icontext) {
 
 inline void loadAndAdd(IContext& context) {
     std::vector shaderNames = { "test.frag.spv", "vertexWire.vert.spv", "debug.frag.spv", "color.frag.spv", "iota.comp.spv", "sort.comp.spv",
-                                "lod.comp.spv", "colorNoDepth.frag.spv", "updateLOD.comp.spv" };
+                                "lod.comp.spv", "colorNoDepth.frag.spv", "updateLOD.comp.spv", "project.comp.spv", "cull.comp.spv" };
     const std::array meshShader = { "testMesh.mesh.spv", "proxyGen.mesh.spv", "dispatch.task.spv" };
     if (context.meshShader) {
         std::ranges::copy(meshShader, std::back_inserter(shaderNames));
     }
+    // Need buffer device addresses for their scratch
+    if (context.packedModels) {
+        shaderNames.push_back("radix.comp.spv");
+        shaderNames.push_back("layer.comp.spv");
+    }
     for (const auto& name : shaderNames) {
-        const auto fileName = (std::filesystem::path("shader") / name).string();
+        // Every shader is also built with PACKED_MODEL as <name>.packed.spv, see shader/model.glsl
+        std::string variant = name;
+        if (context.packedModels) variant.insert(variant.size() - 4, ".packed");
+        const auto fileName = (std::filesystem::path("shader") / variant).string();
         const auto loadValues = readFullFile(fileName);
         vk::ShaderModuleCreateInfo shaderModuleCreateInfo({}, loadValues.size(), (uint32_t*)loadValues.data());
         const auto shaderModule = context.device.createShaderModule(shaderModuleCreateInfo);
@@ -175,6 +714,7 @@ inline void loadAndAdd(IContext& context) {
 }
 
 inline void recreatePipeline(IContext& context) {
+    clearCommandCache(context);
     for (size_t i = 0; i < PIPELINE_TYPE_AMOUNT; i++)
     {
         const auto pipe = getFromType((PipelineType)i, context);
@@ -288,8 +828,19 @@ inline void createShaderPipelines(IContext& context) {
         vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer,
                     1, flagBitsForBindings),
         vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer,
+                    1, flagBitsForBindings),
+        vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer,
+                    1, flagBitsForBindings),
+        vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer,
+                    1, flagBitsForBindings),
+        vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer,
+                    1, flagBitsForBindings),
+        vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer,
+                    1, flagBitsForBindings),
+        vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer,
                     1, flagBitsForBindings) };
-    const vk::DescriptorSetLayoutCreateInfo descriptorSetCreateInfo({}, bindings);
+    // Packed models only keep the camera in a descriptor
+    const vk::DescriptorSetLayoutCreateInfo descriptorSetCreateInfo({}, context.packedModels ? 1u : (uint32_t)bindings.size(), bindings.data());
     context.defaultDescriptorSetLayout = context.device.createDescriptorSetLayout(descriptorSetCreateInfo);
 
     const std::array lodBindings = {
@@ -302,10 +853,12 @@ inline void createShaderPipelines(IContext& context) {
     const vk::DescriptorSetLayoutCreateInfo lodBindingsSetCreateInfo({}, lodBindings);
     context.lodDescriptorSetLayout = context.device.createDescriptorSetLayout(lodBindingsSetCreateInfo);
 
-    std::array pushConsts{ vk::PushConstantRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t) * 2} };
+    context.modelStages = flagBitsForBindings;
+    std::array pushConsts{ vk::PushConstantRange{context.modelStages, 0, sizeof(ModelPushConstants)} };
 
     std::array descriptorSets = { context.defaultDescriptorSetLayout, context.lodDescriptorSetLayout };
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreate({}, descriptorSets, pushConsts);
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreate({}, context.packedModels ? 1u : (uint32_t)descriptorSets.size(), descriptorSets.data(),
+        (uint32_t)pushConsts.size(), pushConsts.data());
     const auto pipelineLayout = context.device.createPipelineLayout(pipelineLayoutCreate);
     context.defaultPipelineLayout = pipelineLayout;
 
@@ -326,6 +879,53 @@ inline void createShaderPipelines(IContext& context) {
     if (result6.result != vk::Result::eSuccess)
         throw std::runtime_error("Pipeline error!");
     context.computeSortPipeline = result6.value;
+    // Same shader with LOCAL_SORT set
+    const vk::SpecializationMapEntry localSortEntry(0, 0, sizeof(vk::Bool32));
+    const vk::Bool32 localSort = VK_TRUE;
+    const vk::SpecializationInfo localSortInfo(1, &localSortEntry, sizeof(localSort), &localSort);
+    auto sortLocalPipelineShaderStages = sortPipelineShaderStages;
+    sortLocalPipelineShaderStages.setPSpecializationInfo(&localSortInfo);
+    computePipeCreateInfo.setStage(sortLocalPipelineShaderStages);
+    const auto resultLocal = context.device.createComputePipeline({}, computePipeCreateInfo);
+    if (resultLocal.result != vk::Result::eSuccess)
+        throw std::runtime_error("Pipeline error!");
+    context.computeSortLocalPipeline = resultLocal.value;
+    // Same shader with REFINE_SORT set
+    const vk::SpecializationMapEntry refineSortEntry(1, 0, sizeof(vk::Bool32));
+    const vk::Bool32 refineSort = VK_TRUE;
+    const vk::SpecializationInfo refineSortInfo(1, &refineSortEntry, sizeof(refineSort), &refineSort);
+    auto sortRefinePipelineShaderStages = sortPipelineShaderStages;
+    sortRefinePipelineShaderStages.setPSpecializationInfo(&refineSortInfo);
+    computePipeCreateInfo.setStage(sortRefinePipelineShaderStages);
+    const auto resultRefine = context.device.createComputePipeline({}, computePipeCreateInfo);
+    if (resultRefine.result != vk::Result::eSuccess)
+        throw std::runtime_error("Pipeline error!");
+    context.computeSortRefinePipeline = resultRefine.value;
+    // One pipeline per stage, selected by specialization constant 0 of the shader
+    const vk::SpecializationMapEntry stageEntry(0, 0, sizeof(uint32_t));
+    const auto createStages = [&](const std::string& shader, const auto& pipelines) {
+        for (uint32_t i = 0; i < pipelines.size(); i++)
+        {
+            const vk::SpecializationInfo stageInfo(1, &stageEntry, sizeof(uint32_t), &i);
+            const vk::PipelineShaderStageCreateInfo stagePipelineShaderStages({}, vk::ShaderStageFlagBits::eCompute,
+                context.shaderModule[shader], "main", &stageInfo);
+            computePipeCreateInfo.setStage(stagePipelineShaderStages);
+            const auto resultStage = context.device.createComputePipeline({}, computePipeCreateInfo);
+            if (resultStage.result != vk::Result::eSuccess)
+                throw std::runtime_error("Pipeline error!");
+            *pipelines[i] = resultStage.value;
+        }
+    };
+    // Vertex and silhouette stage of project.comp
+    createStages("project.comp.spv", std::array{ &context.computeProjectVerticesPipeline, &context.computeProjectSilhouettesPipeline });
+    createStages("cull.comp.spv", std::array{ &context.computeCullPipeline });
+    if (context.packedModels) {
+        // Key stage for centroid and farthest vertex and the scatter stage of radix.comp
+        createStages("radix.comp.spv", std::array{ &context.computeRadixKeyPipeline, &context.computeRadixKeyFarthestPipeline,
+            &context.computeRadixScatterPipeline });
+        createStages("layer.comp.spv", std::array{ &context.computeLayerClassifyPipeline, &context.computeLayerPreparePipeline,
+            &context.computeLayerReleasePipeline, &context.computeLayerRemainderPipeline });
+    }
     computePipeCreateInfo.setStage(lodPipelineShaderStages);
     const auto result7 = context.device.createComputePipeline({}, computePipeCreateInfo);
     if (result7.result != vk::Result::eSuccess)
@@ -360,98 +960,58 @@ inline void destroyShaderPipelines(IContext& context) {
     }
     context.device.destroy(context.computeInitPipeline);
     context.device.destroy(context.computeSortPipeline);
+    context.device.destroy(context.computeSortLocalPipeline);
+    context.device.destroy(context.computeSortRefinePipeline);
+    context.device.destroy(context.computeProjectVerticesPipeline);
+    context.device.destroy(context.computeProjectSilhouettesPipeline);
+    context.device.destroy(context.computeCullPipeline);
+    context.device.destroy(context.computeRadixKeyPipeline);
+    context.device.destroy(context.computeRadixKeyFarthestPipeline);
+    context.device.destroy(context.computeRadixScatterPipeline);
+    context.device.destroy(context.computeLayerClassifyPipeline);
+    context.device.destroy(context.computeLayerPreparePipeline);
+    context.device.destroy(context.computeLayerReleasePipeline);
+    context.device.destroy(context.computeLayerRemainderPipeline);
     context.device.destroy(context.computeLODPipeline);
     context.device.destroy(context.computeLODUpdatePipeline);
 }
 
-struct CameraInfo {
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
-    glm::mat4 whole;
-    glm::mat4 inverse;
-    glm::vec4 colorADepth;
-    float lod;
-    uint32_t type;
-};
-
-constexpr float INTERNAL_PI = 3.14159265358979323846  /* pi */;
-
-inline void updateCamera(IContext & context) {
-    CameraInfo* cameraMap = (CameraInfo*)context.device.mapMemory(context.cameraStagingMemory, 0, VK_WHOLE_SIZE);
-    const float aspect = context.currentExtent.width / (float)context.currentExtent.height;
-    auto projectionMatrix = glm::perspective(context.settings.FOV, aspect, context.settings.planes.x, context.settings.planes.y);
-    projectionMatrix[1][1] *= -1;
-    cameraMap->proj = projectionMatrix;
-    float yaw = context.settings.rotationAndZoom.x;
-    float pitch = context.settings.rotationAndZoom.y - INTERNAL_PI*0.5;
-    glm::vec3 lookAt;
-    lookAt.x = std::cos(yaw) * std::cos(pitch);
-    lookAt.y = std::sin(pitch);
-    lookAt.z = std::sin(yaw) * std::cos(pitch);
-    lookAt = glm::normalize(lookAt);
-    lookAt *= context.settings.rotationAndZoom.z;
-
-    cameraMap->view = glm::lookAt(context.settings.position + lookAt, context.settings.position, glm::vec3{ 0.0f, 1.0f, 0.0f });
-    cameraMap->model = glm::identity<glm::mat4>();
-    cameraMap->whole = projectionMatrix * cameraMap->view * cameraMap->model;
-    cameraMap->inverse = glm::inverse(projectionMatrix * cameraMap->view);
-    cameraMap->colorADepth = context.settings.colorADepth;
-    const auto values = ((uint32_t)context.settings.currentLOD);
-    cameraMap->lod = context.settings.currentLOD - values;
-    cameraMap->type = (context.oldLOD < values ? 1 : 0);
-    if (cameraMap->type == 0) {
-        const auto oldValues = ((uint32_t)context.oldLOD);
-        cameraMap->type = (context.settings.currentLOD < oldValues ? 2 : 0);
-    }
-    context.oldLOD = context.settings.currentLOD;
-    context.changedLOD = cameraMap->type;
-#ifndef NDEBUG
-    if (context.changedLOD) {
-        assert(cameraMap->type == 1 || cameraMap->type == 2);
-        if (cameraMap->type == 1) std::cout << "Changed LOD Level up" << std::endl;
-        else std::cout << "Changed LOD Level down" << std::endl;
-    }
-#endif // !NDEBUG
-
-    context.device.unmapMemory(context.cameraStagingMemory);
-
-    const auto [buffer, fence] = context.commandBuffer.get<DataCommandBuffer::DataUpload>();
-    vk::CommandBufferBeginInfo beginInfo;
-    buffer.begin(beginInfo);
-    vk::BufferCopy bufferCopy(0, 0, sizeof(CameraInfo));
-    buffer.copyBuffer(context.stagingCamera, context.uniformCamera, bufferCopy);
-    buffer.end();
-
-    std::array buffers = { buffer };
-    vk::SubmitInfo submitInfo({}, {}, buffers, {});
-    context.primaryQueue.submit(submitInfo, fence);
-    const auto result = context.device.waitForFences(fence, true, std::numeric_limits<uint64_t>().max());
-    if (result != vk::Result::eSuccess)
-        throw std::runtime_error("Wait for fence failed!");
-    context.device.resetFences(fence);
-}
-
 inline void createBuffer(IContext& context) {
     std::array queueFamily = { context.primaryFamilyIndex };
-    vk::BufferCreateInfo bufferCreateInfo({}, sizeof(CameraInfo), vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, queueFamily);
+    // One slot per frame in flight, a slot is only rewritten after the fence of its frame signaled
+    vk::BufferCreateInfo bufferCreateInfo({}, sizeof(CameraInfo) * MAX_FRAMES_IN_FLIGHT, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::SharingMode::eExclusive, queueFamily);
     context.stagingCamera = context.device.createBuffer(bufferCreateInfo);
+    bufferCreateInfo.size = sizeof(CameraInfo);
     bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer;
     context.uniformCamera = context.device.createBuffer(bufferCreateInfo);
-    const auto stagingSize = context.device.getBufferMemoryRequirements(context.stagingCamera).size;
-    const auto uniformSize = context.device.getBufferMemoryRequirements(context.uniformCamera).size;
-
-    context.cameraStagingMemory = context.requestMemory(stagingSize, vk::MemoryPropertyFlagBits::eHostVisible);
-    context.cameraMemory = context.requestMemory(uniformSize, vk::MemoryPropertyFlagBits::eDeviceLocal);
-    context.device.bindBufferMemory(context.stagingCamera, context.cameraStagingMemory, 0);
-    context.device.bindBufferMemory(context.uniformCamera, context.cameraMemory, 0);
+    const auto stagingRequirements = context.device.getBufferMemoryRequirements(context.stagingCamera);
+    const auto uniformRequirements = context.device.getBufferMemoryRequirements(context.uniformCamera);
+
+    context.cameraStagingMemory = context.requestMemory(stagingRequirements,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryStrategy::Linear);
+    context.cameraMemory = context.requestMemory(uniformRequirements, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryStrategy::Linear);
+    context.device.bindBufferMemory(context.stagingCamera, context.cameraStagingMemory.memory, context.cameraStagingMemory.offset);
+    context.device.bindBufferMemory(context.uniformCamera, context.cameraMemory.memory, context.cameraMemory.offset);
+
+    if (context.packedModels) {
+        const vk::DescriptorSetAllocateInfo allocateInfo(context.descriptorPool, context.defaultDescriptorSetLayout);
+        context.cameraDescriptor = context.device.allocateDescriptorSets(allocateInfo)[0];
+        const vk::DescriptorBufferInfo descriptorCameraInfo(context.uniformCamera, 0, VK_WHOLE_SIZE);
+        const vk::WriteDescriptorSet writeCameraSet(context.cameraDescriptor, 0, 0, vk::DescriptorType::eUniformBuffer, {}, descriptorCameraInfo);
+        context.device.updateDescriptorSets(writeCameraSet, {});
+    }
 
-    updateCamera(context);
+    // Every primary buffer copies its slot first, so nothing has to be submitted here
+    updateCamera(context, 0);
 }
 
 inline void destroyBuffer(IContext& context) {
-    context.device.freeMemory(context.cameraMemory);
-    context.device.freeMemory(context.cameraStagingMemory);
+    destroyRadixScratch(context);
+    for (auto& frame : context.commandBuffer.frames)
+        destroyOrderStaging(context, frame);
     context.device.destroy(context.uniformCamera);
     context.device.destroy(context.stagingCamera);
+    context.releaseMemory(context.cameraMemory);
+    context.releaseMemory(context.cameraStagingMemory);
 }
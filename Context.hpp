@@ -2,6 +2,14 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <deque>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <bit>
+#include <tuple>
 
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
@@ -12,10 +20,55 @@ enum class DataCommandBuffer {
     Last = DataUpload
 };
 
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// Range of a MemoryAllocator block, buffers are bound at memory/offset. mapped is set for host visible memory
+struct MemoryAllocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    char* mapped = nullptr;
+    uint32_t pool = UINT32_MAX;
+    uint32_t block = 0;
+    // Range taken out of the block including the alignment padding
+    vk::DeviceSize rangeOffset = 0;
+    vk::DeviceSize rangeSize = 0;
+};
+
+// Owned by one frame in flight, the slot is only reused after its fence signaled
+struct FrameData {
+    vk::CommandBuffer primary;
+    // Secondary for the ImGui draw data, the only part of the render pass recorded every frame
+    vk::CommandBuffer imgui;
+    vk::Semaphore acquire;
+    vk::Fence fence;
+    // Two timestamps around the projection and sort secondaries, readable once the fence signaled
+    vk::QueryPool timestamps;
+    bool sortTimed = false;
+    // Host visible copy source of the CPU visibility orders, grown once the fence signaled
+    vk::Buffer orderStaging;
+    MemoryAllocation orderStagingMemory;
+    vk::DeviceSize orderStagingSize = 0;
+};
+
 struct CommandBufferContext {
     vk::CommandPool primaryPool;
     vk::CommandPool uploadAndDataPool;
-    std::vector<vk::CommandBuffer> primaryBuffers;
+    std::array<FrameData, MAX_FRAMES_IN_FLIGHT> frames;
+    // One per swapchain image, the presentation can still wait on it after the fence of the frame signaled
+    std::vector<vk::Semaphore> renderFinished;
+    // Secondary buffers recorded once per model and state and then only executed, keyed by the model buffer
+    // and (pipeline type, LOD level) for draws or (LOD level, direction of the LOD change) for the LOD dispatches
+    using CacheKey = std::tuple<vk::Buffer, uint32_t, uint32_t>;
+    vk::CommandPool cachePool;
+    std::map<CacheKey, vk::CommandBuffer> cachedDraws;
+    std::map<CacheKey, vk::CommandBuffer> cachedLOD;
+    // Radix and layer sorts, keyed by the model buffer, the sort type and the layer rounds
+    std::map<CacheKey, vk::CommandBuffer> cachedSorts;
+    // Refine passes, keyed by the model buffer and the amount of passes
+    std::map<CacheKey, vk::CommandBuffer> cachedRefines;
+    // Projection prepass and cluster culling, keyed by the model buffer only
+    std::map<CacheKey, vk::CommandBuffer> cachedProjections;
     std::array<vk::CommandBuffer, (size_t)DataCommandBuffer::Last + 1> dataCommandBuffer;
     std::array<vk::Fence, (size_t)DataCommandBuffer::Last + 1> dataCommandFences;
 
@@ -25,6 +78,270 @@ struct CommandBufferContext {
     }
 };
 
+// Linear pools only bump an offset and are reset once all of their allocations in a block are freed,
+// meant for allocations living as long as the context. Free list pools serve everything else
+enum class MemoryStrategy {
+    FreeList, Linear
+};
+
+struct MemoryStatistics {
+    // Live vkAllocateMemory calls and the calls since creation
+    size_t deviceAllocations = 0;
+    size_t totalDeviceAllocations = 0;
+    size_t subAllocations = 0;
+    vk::DeviceSize reservedBytes = 0;
+    vk::DeviceSize usedBytes = 0;
+};
+
+// Hands out ranges of large blocks, so vkAllocateMemory is only called once per block instead of once
+// per buffer. Requests above half a block get a dedicated block. Safe to use from several threads
+struct MemoryAllocator {
+    struct Block {
+        vk::DeviceMemory memory;
+        vk::DeviceSize size = 0;
+        char* mapped = nullptr;
+        size_t allocations = 0;
+        bool dedicated = false;
+        // Linear: next free offset
+        vk::DeviceSize head = 0;
+        // Free list: offset to size of the free ranges, neighbouring ranges are always merged
+        std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+    };
+
+    struct Pool {
+        uint32_t memoryType = 0;
+        MemoryStrategy strategy = MemoryStrategy::FreeList;
+        vk::DeviceSize blockSize = 0;
+        std::vector<Block> blocks;
+    };
+
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties properties;
+    // Blocks are allocated with the device address flag, required for buffers with shader device addresses
+    bool deviceAddress = false;
+    vk::DeviceSize preferredBlockSize = 64ull << 20;
+    std::vector<Pool> pools;
+    MemoryStatistics statistics;
+    std::mutex mutex;
+
+    // Type allowed by typeBits with all of required and as few other flags as possible, so device local
+    // data does not end up in host visible memory or a slower heap
+    inline uint32_t findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required) const {
+        uint32_t memoryTypeIndex = UINT32_MAX;
+        int fewestExtraFlags = std::numeric_limits<int>::max();
+        for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
+        {
+            const auto flags = properties.memoryTypes[i].propertyFlags;
+            if (!(typeBits & (1u << i)) || (flags & required) != required) continue;
+            const auto extraFlags = std::popcount((VkMemoryPropertyFlags)(flags & ~required));
+            if (extraFlags < fewestExtraFlags) {
+                fewestExtraFlags = extraFlags;
+                memoryTypeIndex = i;
+            }
+        }
+        if (memoryTypeIndex == UINT32_MAX) throw std::runtime_error("No memory type with the requested properties!");
+        return memoryTypeIndex;
+    }
+
+    inline MemoryAllocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags flags, MemoryStrategy strategy) {
+        const auto memoryType = findMemoryType(requirements.memoryTypeBits, flags);
+        const auto alignment = std::max<vk::DeviceSize>(1u, requirements.alignment);
+        const std::lock_guard lock(mutex);
+        const auto poolIndex = findPool(memoryType, strategy);
+        auto& pool = pools[poolIndex];
+
+        MemoryAllocation allocation;
+        allocation.pool = (uint32_t)poolIndex;
+        allocation.size = requirements.size;
+        const auto take = [&](size_t blockIndex) {
+            auto& block = pool.blocks[blockIndex];
+            if (!tryAllocate(pool, block, requirements.size, alignment, allocation)) return false;
+            block.allocations++;
+            allocation.memory = block.memory;
+            allocation.block = (uint32_t)blockIndex;
+            allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+            statistics.subAllocations++;
+            statistics.usedBytes += allocation.rangeSize;
+            return true;
+        };
+        if (requirements.size > pool.blockSize / 2) {
+            take(createBlock(pool, requirements.size, true));
+            return allocation;
+        }
+        for (size_t i = 0; i < pool.blocks.size(); i++)
+            if (pool.blocks[i].memory && !pool.blocks[i].dedicated && take(i)) return allocation;
+        take(createBlock(pool, pool.blockSize, false));
+        return allocation;
+    }
+
+    inline void free(const MemoryAllocation& allocation) {
+        if (allocation.pool == UINT32_MAX) return;
+        const std::lock_guard lock(mutex);
+        auto& pool = pools[allocation.pool];
+        auto& block = pool.blocks[allocation.block];
+        statistics.subAllocations--;
+        statistics.usedBytes -= allocation.rangeSize;
+        block.allocations--;
+        if (pool.strategy == MemoryStrategy::Linear) {
+            if (block.allocations == 0) block.head = 0;
+        }
+        else {
+            auto [range, inserted] = block.freeRanges.emplace(allocation.rangeOffset, allocation.rangeSize);
+            if (range != block.freeRanges.begin()) {
+                const auto previous = std::prev(range);
+                if (previous->first + previous->second == range->first) {
+                    previous->second += range->second;
+                    block.freeRanges.erase(range);
+                    range = previous;
+                }
+            }
+            const auto next = std::next(range);
+            if (next != block.freeRanges.end() && range->first + range->second == next->first) {
+                range->second += next->second;
+                block.freeRanges.erase(next);
+            }
+        }
+        // Dedicated blocks go back right away, of the others one empty block per pool is kept
+        if (block.allocations == 0 && (block.dedicated || std::ranges::any_of(pool.blocks, [&](const Block& other) {
+            return &other != &block && other.memory && !other.dedicated && other.allocations == 0; })))
+            destroyBlock(block);
+    }
+
+    inline MemoryStatistics currentStatistics() {
+        const std::lock_guard lock(mutex);
+        return statistics;
+    }
+
+    inline void destroy() {
+        for (auto& pool : pools)
+            for (auto& block : pool.blocks)
+                if (block.memory) destroyBlock(block);
+        pools.clear();
+    }
+
+private:
+    inline size_t findPool(uint32_t memoryType, MemoryStrategy strategy) {
+        for (size_t i = 0; i < pools.size(); i++)
+            if (pools[i].memoryType == memoryType && pools[i].strategy == strategy) return i;
+        const auto heapSize = properties.memoryHeaps[properties.memoryTypes[memoryType].heapIndex].size;
+        pools.push_back({ memoryType, strategy, std::min(preferredBlockSize, heapSize / 8) });
+        return pools.size() - 1;
+    }
+
+    inline bool tryAllocate(const Pool& pool, Block& block, vk::DeviceSize size, vk::DeviceSize alignment, MemoryAllocation& allocation) {
+        const auto alignUp = [=](vk::DeviceSize value) { return (value + alignment - 1) / alignment * alignment; };
+        if (pool.strategy == MemoryStrategy::Linear) {
+            const auto offset = alignUp(block.head);
+            if (offset + size > block.size) return false;
+            allocation.offset = offset;
+            allocation.rangeOffset = block.head;
+            allocation.rangeSize = offset + size - block.head;
+            block.head = offset + size;
+            return true;
+        }
+        for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); range++)
+        {
+            const auto [rangeOffset, rangeSize] = *range;
+            const auto offset = alignUp(rangeOffset);
+            if (offset + size > rangeOffset + rangeSize) continue;
+            block.freeRanges.erase(range);
+            if (offset + size < rangeOffset + rangeSize)
+                block.freeRanges.emplace(offset + size, rangeOffset + rangeSize - offset - size);
+            allocation.offset = offset;
+            allocation.rangeOffset = rangeOffset;
+            allocation.rangeSize = offset + size - rangeOffset;
+            return true;
+        }
+        return false;
+    }
+
+    inline size_t createBlock(Pool& pool, vk::DeviceSize size, bool dedicated) {
+        vk::MemoryAllocateInfo memoryAllocationInfo(size, pool.memoryType);
+        const vk::MemoryAllocateFlagsInfo allocateFlags(vk::MemoryAllocateFlagBits::eDeviceAddress);
+        if (deviceAddress) memoryAllocationInfo.setPNext(&allocateFlags);
+        Block block;
+        block.memory = device.allocateMemory(memoryAllocationInfo);
+        block.size = size;
+        block.dedicated = dedicated;
+        if (pool.strategy == MemoryStrategy::FreeList) block.freeRanges.emplace(0, size);
+        if (properties.memoryTypes[pool.memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+            block.mapped = (char*)device.mapMemory(block.memory, 0, VK_WHOLE_SIZE);
+        statistics.deviceAllocations++;
+        statistics.totalDeviceAllocations++;
+        statistics.reservedBytes += size;
+        // Slots of destroyed blocks are reused, indices of live allocations stay valid
+        for (size_t i = 0; i < pool.blocks.size(); i++)
+        {
+            if (pool.blocks[i].memory) continue;
+            pool.blocks[i] = std::move(block);
+            return i;
+        }
+        pool.blocks.push_back(std::move(block));
+        return pool.blocks.size() - 1;
+    }
+
+    inline void destroyBlock(Block& block) {
+        if (block.mapped) device.unmapMemory(block.memory);
+        device.freeMemory(block.memory);
+        statistics.deviceAllocations--;
+        statistics.reservedBytes -= block.size;
+        block = Block{};
+    }
+};
+
+// Scratch of the radix and the layer sort shared by every model and sized for the largest one, it starts
+// with the addresses of its arrays (RadixScratch in shader/radix.comp)
+struct RadixScratch {
+    vk::Buffer buffer;
+    MemoryAllocation memory;
+    vk::DeviceAddress address = 0;
+    size_t capacity = 0;
+    // Histograms and tile counters are cleared once per sort, the look-back states before every pass
+    vk::DeviceSize countersOffset = 0;
+    vk::DeviceSize countersSize = 0;
+    vk::DeviceSize statusOffset = 0;
+    vk::DeviceSize statusSize = 0;
+};
+
+// Persistently mapped staging ring for uploads into device local buffers. Copies are collected in one
+// command buffer and submitted together on the transfer queue, every submit increments the timeline
+struct UploadManager {
+    struct Batch {
+        vk::CommandBuffer commandBuffer;
+        uint64_t value;
+        vk::DeviceSize bytes;
+    };
+
+    vk::Queue queue;
+    vk::CommandPool pool;
+    vk::Buffer stagingBuffer;
+    MemoryAllocation stagingMemory;
+    char* mapped = nullptr;
+    vk::DeviceSize ringSize = 0;
+    vk::DeviceSize head = 0;
+    vk::DeviceSize used = 0;
+    vk::Semaphore timeline;
+    uint64_t submitted = 0;
+    vk::CommandBuffer recording;
+    vk::DeviceSize recordingBytes = 0;
+    std::vector<vk::BufferMemoryBarrier> recordedCopies;
+    // Flushed copies the graphics queue did not acquire yet
+    std::vector<vk::BufferMemoryBarrier> pendingAcquires;
+    std::deque<Batch> inFlight;
+    std::vector<vk::CommandBuffer> freeCommandBuffers;
+};
+
+// Push constants of every pipeline, same layout as PushConstants in shader/model.glsl. model is the
+// address of the ModelHeader with packedModels, level selects the LOD arrays, k and j are the sort step
+// and scratch is the address of the RadixScratch header for the radix and the layer sort
+struct ModelPushConstants {
+    vk::DeviceAddress model = 0;
+    uint32_t level = 0;
+    uint32_t k = 0;
+    uint32_t j = 0;
+    vk::DeviceAddress scratch = 0;
+};
+
 enum class PipelineType {
     Wireframe, Proxy, ProxyABuffer, ColorNoDepth, Color
 };
@@ -50,10 +367,82 @@ namespace std {
     }
 }
 
+// Bitonic compares the projected tetrahedrons, the radix sorts order them by one view depth each and
+// FaceGraph sorts the front/behind graph of the shared faces on the CPU, FaceLayers peels it on the GPU
+enum class SortType {
+    Bitonic, RadixCentroid, RadixFarthest, FaceGraph, FaceLayers
+};
+constexpr size_t SORT_TYPE_AMOUNT = (size_t)SortType::FaceLayers + 1;
+
+namespace std {
+    inline std::string to_string(SortType type) {
+        switch (type)
+        {
+        case SortType::Bitonic:
+            return "Bitonic";
+        case SortType::RadixCentroid:
+            return "Radix centroid depth";
+        case SortType::RadixFarthest:
+            return "Radix farthest vertex depth";
+        case SortType::FaceGraph:
+            return "Face graph (CPU)";
+        case SortType::FaceLayers:
+            return "Face graph layers (GPU)";
+        default:
+            throw std::runtime_error("Sort type not found");
+        }
+    }
+}
+
+// What the incremental sort did in the last frame
+enum class SortPass {
+    Skipped, Refine, Full
+};
+
+namespace std {
+    inline std::string to_string(SortPass pass) {
+        switch (pass)
+        {
+        case SortPass::Skipped:
+            return "Skipped";
+        case SortPass::Refine:
+            return "Refine";
+        case SortPass::Full:
+            return "Full";
+        default:
+            throw std::runtime_error("Sort pass not found");
+        }
+    }
+}
+
+// Camera, LOD and models of the last sorted frame, the incremental sort compares against them. A default
+// constructed state forces a full sort
+struct SortState {
+    bool valid = false;
+    SortType type = SortType::Bitonic;
+    std::vector<vk::Buffer> models;
+    glm::mat4 whole{ 0.0f };
+    float lod = 0.0f;
+    // Eye position at the last full sort
+    glm::vec3 eye{ 0.0f };
+    SortPass lastPass = SortPass::Full;
+    // Of the last CPU face graph order over all models
+    float orderTime = 0.0f;
+    size_t cycleBreaks = 0;
+};
+
 struct ContextSetting {
     // General
     PipelineType type = PipelineType::Wireframe;
     bool sortingOfPrimitives = false;
+    // Radix sorts and FaceLayers need packedModels, models without a CPU copy fall back to bitonic for FaceGraph
+    SortType sortType = SortType::Bitonic;
+    // Layers FaceLayers peels per sort, the tetrahedrons left after them are appended unordered
+    int layerRounds = 512;
+    // Starts from the order of the last frame, the sort type above only runs past fullSortAngle
+    bool incrementalSort = false;
+    int refinePasses = 2;
+    float fullSortAngle = glm::radians(10.0f);
     std::vector<char> activeModels = std::vector<char>(5u, false);
     // Camera
     glm::vec2 planes{ 0.01f, 100.0f };
@@ -126,11 +515,17 @@ struct IContext {
     vk::Instance instance;
     // Use mesh shader
     bool meshShader = false;
+    // Every model in one buffer reached through buffer device addresses instead of per model descriptor sets
+    bool packedModels = false;
+    vk::DeviceSize storageAlignment = 16;
+    // Nanoseconds per timestamp tick, 0 if the queue can't write timestamps
+    float timestampPeriod = 0.0f;
     // Device Creation
     vk::Device device;
     vk::PhysicalDevice physicalDevice;
     std::vector<vk::QueueFamilyProperties> queueFamilyProperties;
     uint32_t primaryFamilyIndex;
+    uint32_t transferFamilyIndex;
     // Surface
     vk::SurfaceKHR surface;
     // Swapchain
@@ -140,6 +535,9 @@ struct IContext {
     std::vector<vk::ImageView> swapchainImages;
     // Command Buffer
     CommandBufferContext commandBuffer;
+    // Between 1 and MAX_FRAMES_IN_FLIGHT, can change at any frame
+    uint32_t framesInFlight = 2;
+    uint32_t currentFrame = 0;
     // Framebuffer/RenderPass
     vk::RenderPass renderPass;
     std::vector<vk::Framebuffer> frameBuffer;
@@ -148,6 +546,9 @@ struct IContext {
     vk::DescriptorSetLayout defaultDescriptorSetLayout;
     vk::DescriptorSetLayout lodDescriptorSetLayout;
     vk::PipelineLayout defaultPipelineLayout;
+    vk::ShaderStageFlags modelStages;
+    // Only the camera, used with packedModels
+    vk::DescriptorSet cameraDescriptor;
     vk::DescriptorPool descriptorPool;    
     vk::Pipeline wireframePipeline;
     vk::Pipeline proxyPipeline;
@@ -156,37 +557,186 @@ struct IContext {
     vk::Pipeline colorNoDepth;
     vk::Pipeline computeInitPipeline;
     vk::Pipeline computeSortPipeline;
+    vk::Pipeline computeSortLocalPipeline;
+    vk::Pipeline computeSortRefinePipeline;
+    vk::Pipeline computeProjectVerticesPipeline;
+    vk::Pipeline computeProjectSilhouettesPipeline;
+    vk::Pipeline computeCullPipeline;
+    vk::Pipeline computeRadixKeyPipeline;
+    vk::Pipeline computeRadixKeyFarthestPipeline;
+    vk::Pipeline computeRadixScatterPipeline;
+    vk::Pipeline computeLayerClassifyPipeline;
+    vk::Pipeline computeLayerPreparePipeline;
+    vk::Pipeline computeLayerReleasePipeline;
+    vk::Pipeline computeLayerRemainderPipeline;
     vk::Pipeline computeLODPipeline;
     vk::Pipeline computeLODUpdatePipeline;
     // Memory
-    vk::DeviceMemory cameraStagingMemory;
-    vk::DeviceMemory cameraMemory;
+    MemoryAllocation cameraStagingMemory;
+    MemoryAllocation cameraMemory;
     vk::Buffer stagingCamera;
     vk::Buffer uniformCamera;
+    RadixScratch radixScratch;
+    SortState sortState;
     // Queue
     vk::Queue primaryQueue;
+    UploadManager upload;
     // Settings
     ContextSetting settings;
     PresetType presetType = PresetType::Default;
     uint32_t changedLOD = 0;
     float oldLOD = 0;
 
-    inline vk::DeviceMemory requestMemory(vk::DeviceSize memorySize, vk::MemoryPropertyFlags flags) {
-        const auto properties = physicalDevice.getMemoryProperties();
-        uint32_t memoryTypeIndex = UINT32_MAX;
-        for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
-        {
-            const auto& type = properties.memoryTypes[i];
-            if (type.propertyFlags & flags) {
-                memoryTypeIndex = i;
-                break;
+    MemoryAllocator memory;
+
+    inline MemoryAllocation requestMemory(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags flags,
+        MemoryStrategy strategy = MemoryStrategy::FreeList) {
+        return memory.allocate(requirements, flags, strategy);
+    }
+
+    inline void releaseMemory(const MemoryAllocation& allocation) {
+        memory.free(allocation);
+    }
+
+};
+
+// Frees the ring space of finished batches, with wait it blocks until the oldest batch finished
+inline void reclaimUploads(IContext& context, bool wait) {
+    auto& upload = context.upload;
+    if (upload.inFlight.empty()) return;
+    if (wait) {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.setSemaphores(upload.timeline);
+        waitInfo.setValues(upload.inFlight.front().value);
+        if (context.device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>().max()) != vk::Result::eSuccess)
+            throw std::runtime_error("Wait for upload failed!");
+    }
+    const auto finished = context.device.getSemaphoreCounterValue(upload.timeline);
+    while (!upload.inFlight.empty() && upload.inFlight.front().value <= finished) {
+        upload.used -= upload.inFlight.front().bytes;
+        upload.freeCommandBuffers.push_back(upload.inFlight.front().commandBuffer);
+        upload.inFlight.pop_front();
+    }
+}
+
+// Submits the recorded copies, a transfer queue of another family releases the buffers to the primary one
+inline void flushUploads(IContext& context) {
+    auto& upload = context.upload;
+    if (!upload.recording) return;
+    if (context.transferFamilyIndex != context.primaryFamilyIndex) {
+        auto releases = upload.recordedCopies;
+        for (auto& barrier : releases) {
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = {};
+            barrier.srcQueueFamilyIndex = context.transferFamilyIndex;
+            barrier.dstQueueFamilyIndex = context.primaryFamilyIndex;
+        }
+        upload.recording.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, releases, {});
+    }
+    upload.recording.end();
+
+    upload.submitted++;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setSignalSemaphoreValues(upload.submitted);
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(upload.recording);
+    submitInfo.setSignalSemaphores(upload.timeline);
+    submitInfo.setPNext(&timelineInfo);
+    upload.queue.submit(submitInfo);
+
+    upload.inFlight.push_back({ upload.recording, upload.submitted, upload.recordingBytes });
+    upload.pendingAcquires.insert(upload.pendingAcquires.end(), upload.recordedCopies.begin(), upload.recordedCopies.end());
+    upload.recordedCopies.clear();
+    upload.recording = nullptr;
+    upload.recordingBytes = 0;
+}
+
+// Offset of size free bytes in the ring, flushes and waits for old batches while the ring is full
+inline vk::DeviceSize reserveUpload(IContext& context, vk::DeviceSize size) {
+    auto& upload = context.upload;
+    while (true) {
+        if (upload.used == 0) upload.head = 0;
+        // An allocation never wraps around, the rest of the ring is skipped instead
+        const auto skipped = upload.head + size > upload.ringSize ? upload.ringSize - upload.head : 0;
+        if (upload.used + skipped + size <= upload.ringSize) {
+            const auto offset = (upload.head + skipped) % upload.ringSize;
+            upload.used += skipped + size;
+            upload.recordingBytes += skipped + size;
+            upload.head = offset + size;
+            return offset;
+        }
+        if (upload.inFlight.empty()) flushUploads(context);
+        reclaimUploads(context, true);
+    }
+}
+
+// Copies size bytes of data into target at targetOffset. Nothing is submitted before flushUploads,
+// the graphics queue may only use target after acquireUploads
+inline void uploadToBuffer(IContext& context, vk::Buffer target, vk::DeviceSize targetOffset, const void* data, vk::DeviceSize size) {
+    auto& upload = context.upload;
+    const auto maxPiece = upload.ringSize / 4 / 16 * 16;
+    const char* source = (const char*)data;
+    for (vk::DeviceSize done = 0; done < size;) {
+        const auto piece = std::min(size - done, maxPiece);
+        const auto offset = reserveUpload(context, (piece + 15) / 16 * 16);
+        std::memcpy(upload.mapped + offset, source + done, piece);
+        if (!upload.recording) {
+            if (upload.freeCommandBuffers.empty()) {
+                const vk::CommandBufferAllocateInfo allocateInfo(upload.pool, vk::CommandBufferLevel::ePrimary, 1);
+                upload.freeCommandBuffers.push_back(context.device.allocateCommandBuffers(allocateInfo)[0]);
             }
+            upload.recording = upload.freeCommandBuffers.back();
+            upload.freeCommandBuffers.pop_back();
+            upload.recording.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
         }
-        vk::MemoryAllocateInfo memoryAllocationInfo(memorySize, memoryTypeIndex);
-        return device.allocateMemory(memoryAllocationInfo);
+        upload.recording.copyBuffer(upload.stagingBuffer, target, vk::BufferCopy(offset, targetOffset + done, piece));
+        upload.recordedCopies.emplace_back(vk::AccessFlags(), vk::AccessFlags(), VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            target, targetOffset + done, piece);
+        done += piece;
     }
+}
 
-};
+// Flushes and records the acquire of everything uploaded so far into commandBuffer. Its submit on the
+// primary queue has to wait for the returned timeline value, see submitAfterUploads
+inline uint64_t acquireUploads(IContext& context, vk::CommandBuffer commandBuffer) {
+    auto& upload = context.upload;
+    flushUploads(context);
+    if (!upload.pendingAcquires.empty()) {
+        const bool ownershipTransfer = context.transferFamilyIndex != context.primaryFamilyIndex;
+        for (auto& barrier : upload.pendingAcquires) {
+            barrier.srcAccessMask = ownershipTransfer ? vk::AccessFlags() : vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+            barrier.srcQueueFamilyIndex = ownershipTransfer ? context.transferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = ownershipTransfer ? context.primaryFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+        }
+        const auto sourceStage = ownershipTransfer ? vk::PipelineStageFlagBits::eTopOfPipe : vk::PipelineStageFlagBits::eTransfer;
+        commandBuffer.pipelineBarrier(sourceStage, vk::PipelineStageFlagBits::eAllCommands, {}, {}, upload.pendingAcquires, {});
+        upload.pendingAcquires.clear();
+    }
+    return upload.submitted;
+}
+
+inline void submitAfterUploads(IContext& context, vk::CommandBuffer commandBuffer, uint64_t uploadValue, vk::Fence fence) {
+    const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setWaitSemaphoreValues(uploadValue);
+    vk::SubmitInfo submitInfo;
+    submitInfo.setWaitSemaphores(context.upload.timeline);
+    submitInfo.setWaitDstStageMask(waitStage);
+    submitInfo.setCommandBuffers(commandBuffer);
+    submitInfo.setPNext(&timelineInfo);
+    context.primaryQueue.submit(submitInfo, fence);
+}
+
+// Forgets the copies into target which were never acquired, before target is destroyed. Waits for the device,
+// the batches in flight may still write into target
+inline void discardUploads(IContext& context, vk::Buffer target) {
+    auto& upload = context.upload;
+    flushUploads(context);
+    context.device.waitIdle();
+    reclaimUploads(context, false);
+    std::erase_if(upload.pendingAcquires, [&](const vk::BufferMemoryBarrier& barrier) { return barrier.buffer == target; });
+}
 
 inline vk::Pipeline getFromType(PipelineType type, const IContext& context) {
     switch (type)
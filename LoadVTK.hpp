@@ -3,103 +3,117 @@
 #include <vector>
 #include <array>
 #include <string>
-#include <glm/glm.hpp>
 #include <iostream>
-#include <bitset>
-
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <optional>
+#include <functional>
+#include <limits>
+#include <cstddef>
+
+#include "Util.hpp"
+#include "MeshCore.hpp"
 #include "Context.hpp"
 
-using VertIndex = uint32_t;
-
-struct Tetrahedron {
-    VertIndex indices[4];
-};
-using TetIndex = uint32_t;
-
-enum class EdgeType : uint32_t {
-   None = 0, Point = 1, Edge = 2, Face = 3, OverPromotion = 4
+// Byte range of one array inside the model buffer, size is 0 for empty arrays
+struct VTKRegion {
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
 };
 
-using Connection = std::tuple<TetIndex, EdgeType>;
-using TetGraph = std::vector<std::vector<Connection>>;
+// Vertices, tetrahedrons, sort indices, then per LOD level the visibility, collapse and change arrays,
+// the four face neighbours of every tetrahedron, the cluster bounds and the cluster of every tetrahedron.
+// Last come the projected vertices, silhouettes and cluster visibility, the projection prepass writes them
+// every frame and they are not part of the staging data
+constexpr size_t FACE_REGION = 3 + LOD_COUNT * 3;
+constexpr size_t CLUSTER_BOUNDS_REGION = FACE_REGION + 1;
+constexpr size_t CLUSTER_REGION = FACE_REGION + 2;
+constexpr size_t SCREEN_VERTEX_REGION = FACE_REGION + 3;
+constexpr size_t SILHOUETTE_REGION = FACE_REGION + 4;
+constexpr size_t CLUSTER_VISIBILITY_REGION = FACE_REGION + 5;
+constexpr size_t REGION_AMOUNT = CLUSTER_VISIBILITY_REGION + 1;
+using VTKRegionArray = std::array<VTKRegion, REGION_AMOUNT>;
+using VTKSizeArray = std::array<vk::DeviceSize, REGION_AMOUNT>;
+using VTKDescriptorArray = std::vector<vk::DescriptorSet>;
 
-struct AABB {
-    glm::vec3 min{ FLT_MAX };
-    glm::vec3 max{ -FLT_MAX };
+// Start of the model buffer with packedModels, same layout as ModelHeader in shader/model.glsl.
+// Levels without an own visibility array point to the one of LOD 0, other empty arrays are 0
+struct ModelHeader {
+    std::array<vk::DeviceAddress, REGION_AMOUNT> regions;
+    uint32_t tetrahedronAmount;
+    uint32_t vertexAmount;
+    uint32_t clusterAmount;
 };
 
-inline AABB extendAABB(const AABB& aabb1, const AABB& aabb2) {
-    return { glm::min(aabb1.min, aabb2.min), glm::max(aabb1.max, aabb2.max) };
-}
-
-struct LODTetrahedron {
-    glm::vec4 previous[4];
-    glm::vec4 next;
-    Tetrahedron tetrahedron;
+// Same layout as Silhouette in shader/model.glsl
+struct Silhouette {
+    glm::vec4 area;
+    glm::vec2 depth;
+    uint32_t outline;
+    uint32_t padding;
 };
 
-struct LODLevelChange {
-    uint32_t indexInTet;
-    uint32_t oldIndex;
-    uint32_t newIndex;
-    uint32_t tetrahedronID;
-};
+// All arrays of a model in one buffer and one allocation
+struct ModelBuffer {
+    vk::Buffer buffer;
+    MemoryAllocation memory;
+    VTKRegionArray regions;
+    vk::DeviceAddress header = 0;
 
-struct LODLevel {
-    std::vector<LODTetrahedron> lodTetrahedrons;
-    std::vector<LODLevelChange> lodLevelChanges;
-    std::vector<char> usageAfter;
-};
-constexpr size_t COLAPSING_PER_LEVEL = 250u;
+    vk::DescriptorBufferInfo info(size_t region) const { return { buffer, regions[region].offset, regions[region].size }; }
 
-enum class LodLevelFlag {
-    None, L1, L2, L3, L4, L5, L6, L7, L8
-};
-constexpr size_t LOD_COUNT = 8;
-enum class Heuristic {
-    Random
-};
-inline std::string stringLODLevel(const LodLevelFlag flag) {
-    switch (flag)
-    {
-    case LodLevelFlag::None: return "None";
-    case LodLevelFlag::L1: return "L1";
-    case LodLevelFlag::L2: return "L2";
-    case LodLevelFlag::L3: return "L3";
-    case LodLevelFlag::L4: return "L4";
-    case LodLevelFlag::L5: return "L5";
-    case LodLevelFlag::L6: return "L6";
-    case LodLevelFlag::L7: return "L7";
-    case LodLevelFlag::L8: return "L8";
-
-    default:
-        throw std::runtime_error("Wrong LODLevelFlag!");
+    void destroy(IContext& context) {
+        context.device.destroy(buffer);
+        context.releaseMemory(memory);
     }
-}
-
-using VTKBufferArray = std::array<vk::Buffer, 3 + LOD_COUNT * 3>;
-using VTKSizeArray = std::array<vk::DeviceSize, 3 + LOD_COUNT * 3>;
-using VTKDescriptorArray = std::vector<vk::DescriptorSet>;
+};
 
 struct VTKFile {
     size_t amountOfTetrahedrons;
-    vk::DeviceMemory memory;
-    VTKBufferArray bufferArray;
+    ModelBuffer data;
     vk::CommandPool sortSecondaryPool;
     vk::CommandBuffer sortSecondary;
+    // Empty with packedModels
     VTKDescriptorArray descriptor;
     AABB aabb;
     std::vector<size_t> lodAmount;
     std::vector<size_t> lodUpdateAmount;
+    // Mesh file, empty for streamed models which are never ordered on the CPU
+    std::string source;
+    // CPU copy for the face graph order, only built while that order is in use, see updateVisibilityMeshes
+    std::shared_ptr<VisibilityMesh> visibility;
 
     void unload(IContext& context) {
-        context.device.freeMemory(memory);
-        for (const auto buffer : bufferArray)
-            context.device.destroy(buffer);
+        data.destroy(context);
         context.device.destroy(sortSecondaryPool);
     }
 };
 
+// The camera set of packedModels, the descriptor sets of a model include the camera otherwise
+inline void bindCamera(IContext& context, vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint) {
+    if (context.packedModels)
+        commandBuffer.bindDescriptorSets(bindPoint, context.defaultPipelineLayout, 0, context.cameraDescriptor, {});
+}
+
+// Makes the arrays of a LOD level visible to the next dispatch or draw, through the push constants
+// with packedModels and through descriptor sets otherwise
+inline void bindModel(IContext& context, vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint,
+    const ModelBuffer& model, const VTKDescriptorArray& descriptor, size_t level) {
+    if (context.packedModels) {
+        const ModelPushConstants constants{ model.header, (uint32_t)level };
+        commandBuffer.pushConstants(context.defaultPipelineLayout, context.modelStages, 0, offsetof(ModelPushConstants, k), &constants);
+        return;
+    }
+    const std::array descriptorsToUse = { descriptor[0], descriptor[level + 1] };
+    commandBuffer.bindDescriptorSets(bindPoint, context.defaultPipelineLayout, 0, descriptorsToUse, {});
+}
+
 uint32_t findPowerAbove(uint32_t n) {
     int k = 1;
     while (k > 0 && k < n)
@@ -107,412 +121,242 @@ uint32_t findPowerAbove(uint32_t n) {
     return k;
 }
 
+// Same as LOCAL_ELEMENTS in sort.comp, one workgroup sorts this many elements in shared memory
+constexpr uint32_t SORT_LOCAL_ELEMENTS = 256;
+
+// Workgroups of one dispatch, more than the 65535 every device supports in x are split over y
+inline std::array<uint32_t, 2> splitWorkGroups(uint32_t groups) {
+    constexpr uint32_t MAX_GROUPS_X = 32768;
+    return { std::min(groups, MAX_GROUPS_X), (groups + MAX_GROUPS_X - 1) / MAX_GROUPS_X };
+}
+
 // Source https://courses.cs.duke.edu//fall08/cps196.1/Pthreads/bitonic.c
-void recordBitonicSort(uint32_t n, vk::CommandBuffer buffer, IContext& context, vk::Buffer sortBuffer) {
+// One invocation per compare pair, all steps with j below SORT_LOCAL_ELEMENTS are fused into one local pass
+void recordBitonicSort(uint32_t n, vk::CommandBuffer buffer, IContext& context, vk::DescriptorBufferInfo sortBuffer) {
     const auto N = findPowerAbove(n);
-    uint32_t j, k;
     const auto flags = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
-    vk::BufferMemoryBarrier bufferMemoryBarrier(flags, flags, context.primaryFamilyIndex, context.primaryFamilyIndex, sortBuffer, 0u, VK_WHOLE_SIZE);
+    vk::BufferMemoryBarrier bufferMemoryBarrier(flags, flags, context.primaryFamilyIndex, context.primaryFamilyIndex, sortBuffer.buffer, sortBuffer.offset, sortBuffer.range);
     buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
-    for (k = 2; k <= N; k = 2 * k) {
-        for (j = k >> 1; j > 0; j = j >> 1) {
-            std::array values = { k, j };
-            buffer.pushConstants(context.defaultPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0u, 2 * sizeof(uint32_t), values.data());
-            buffer.dispatch(n, 1, 1);
-            buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
+    const auto [groupsX, groupsY] = splitWorkGroups(std::max(1u, N / SORT_LOCAL_ELEMENTS));
+    const auto sortPass = [&](vk::Pipeline pipeline, uint32_t k, uint32_t j) {
+        const std::array values = { k, j };
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        buffer.pushConstants(context.defaultPipelineLayout, context.modelStages, offsetof(ModelPushConstants, k), 2 * sizeof(uint32_t), values.data());
+        buffer.dispatch(groupsX, groupsY, 1);
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
+    };
+    if (N >= 2) {
+        // Every stage up to SORT_LOCAL_ELEMENTS at once, then per stage the global steps and one local pass
+        sortPass(context.computeSortLocalPipeline, std::min(N, SORT_LOCAL_ELEMENTS), 2);
+        for (uint32_t k = 2 * SORT_LOCAL_ELEMENTS; k <= N && k != 0; k <<= 1) {
+            for (uint32_t j = k >> 1; j >= SORT_LOCAL_ELEMENTS; j >>= 1)
+                sortPass(context.computeSortPipeline, k, j);
+            sortPass(context.computeSortLocalPipeline, k, k);
         }
     }
     buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
 }
 
+// Odd-even rounds of one refine pass, a tetrahedron moves at most this far per pass
+constexpr uint32_t SORT_REFINE_ROUNDS = SORT_LOCAL_ELEMENTS / 4;
 
-struct LODGenerateInfo {
-    const std::vector<char>& previous;
-    const std::vector<char>& outer;
-    const std::vector<LODTetrahedron>& previousTets;
-    TetGraph& graph;
-    IContext& context;
-    LodLevelFlag level;
-    Heuristic heuristic;
-    std::string name;
-};
-
-inline LODLevel defaultLODLevel(IContext& context, const TetGraph& graph) {
-    LODLevel level;
-    level.usageAfter.resize(graph.size(), true);
-    return level;
-}
-
-inline LODLevel loadLODLevel(const LODGenerateInfo& lodGenerateInfo, std::vector<glm::vec4>& vertices,
-    std::vector<Tetrahedron>& tetrahedrons) {
-
-    LODLevel level;
-    level.usageAfter = lodGenerateInfo.previous;
-    level.lodLevelChanges.reserve(COLAPSING_PER_LEVEL * 4);
-    auto usageForCurrentLOD = lodGenerateInfo.previous;
-
-    std::vector<std::vector<size_t>> indexToTetrahedron(vertices.size());
-    size_t index = 0;
-    for (const auto& previous : lodGenerateInfo.previousTets) {
-        for (const auto& vertIndex : previous.tetrahedron.indices)
-        {
-            indexToTetrahedron[vertIndex].push_back(index);
-        }
-        index++;
-    }
-
-    std::vector<size_t> preyTetrahedron;
-    preyTetrahedron.reserve(COLAPSING_PER_LEVEL);
-    for (size_t i = 0; i < lodGenerateInfo.graph.size(); i++)
-    {
-        if (level.lodTetrahedrons.size() == COLAPSING_PER_LEVEL)
-            break;
-        if (!usageForCurrentLOD[i] || !lodGenerateInfo.outer[i])
-            continue;
-        const auto preyIndex = i;
-        const auto& neighbours = lodGenerateInfo.graph[preyIndex];
-        const auto& prey = tetrahedrons[preyIndex];
-        // Barycentric middle
-        glm::vec4 all(0);
-        for (size_t i = 0; i < 4; i++)
-        {
-            all += vertices[prey.indices[i]];
-        }
-        all /= 4.0f;
-        const glm::vec3 midPoint = all;
-        const std::span preySpan = prey.indices;
-        bool flipping = false;
-        std::vector<std::pair<TetIndex, uint32_t>> connectingPoint(neighbours.size());
-        size_t indexOfNeighbour = 0;
-        for (const auto& [connecting, type] : neighbours)
-        {
-            indexOfNeighbour++;
-            if (type != EdgeType::Point) continue;
-            if (!lodGenerateInfo.previous[connecting]) continue;
-            const auto& other = tetrahedrons[connecting];
-            std::array<VertIndex, 3> usedForPlane;
-            size_t amountFound = 0;
-            VertIndex otherPoint;
-            VertIndex otherIndex;
-            for (size_t i = 0; i < 4; i++)
-            {
-                const auto index = other.indices[i];
-                if (std::ranges::find(preySpan, index) != preySpan.end()) {
-                    otherPoint = index;
-                    otherIndex = i;
-                    continue;
-                }
-                assert(amountFound < 3);
-                usedForPlane[amountFound++] = index;
-            }
-            assert(amountFound == 3);
-            connectingPoint[indexOfNeighbour - 1] = { otherPoint, otherIndex };
-            // Test plane for flips
-            const auto& point2 = vertices[usedForPlane[0]];
-            const glm::vec3 v0 = vertices[usedForPlane[1]] - point2;
-            const glm::vec3 v1 = vertices[usedForPlane[2]] - point2;
-            assert(v0 != glm::vec3(0));
-            assert(v1 != glm::vec3(0));
-            const auto planeNormal = glm::normalize(glm::cross(v0, v1));
-            const glm::vec3 oldVertex = vertices[otherPoint] - point2;
-            assert(oldVertex != glm::vec3(0));
-            const auto signOld = glm::sign(glm::dot(planeNormal, oldVertex));
-            const auto signNew = glm::sign(glm::dot(planeNormal, midPoint - glm::vec3(point2)));
-            if (signOld != signNew) {
-                flipping = true;
-                break;
-            }
-        }
-        if (flipping) continue;
-
-        {
-            auto& lodInfo = level.lodTetrahedrons.emplace_back();
-            lodInfo.tetrahedron = tetrahedrons[preyIndex];
-            lodInfo.next = all;
-            for (size_t i = 0; i < 4; i++)
-            {
-                const auto currentPoint = vertices[prey.indices[i]];
-                lodInfo.previous[i] = currentPoint;
-            }
-        }
-        preyTetrahedron.push_back(i);
-        level.usageAfter[preyIndex] = 0;
-        usageForCurrentLOD[preyIndex] = 0;
-        indexOfNeighbour = 0;
-        const auto newIndex = prey.indices[0];
-        for (const auto& [connecting, type] : neighbours)
-        {
-            // Every neighbour should be excluded from the same LOD Level
-            usageForCurrentLOD[connecting] = 0;
-            for (const auto& [secondDegreeNeighbor, t] : lodGenerateInfo.graph[connecting]) {
-                usageForCurrentLOD[secondDegreeNeighbor] = 0;
-            }
-            indexOfNeighbour++;
-            if (type == EdgeType::Point) {
-                if (!lodGenerateInfo.previous[connecting]) continue;
-                const auto [point, index] = connectingPoint[indexOfNeighbour - 1];
-                if(index == newIndex) continue;
-                level.lodLevelChanges.emplace_back(index, point, newIndex, connecting);
-                continue;
-            }
-            // Only Edge and Face connections are actually collapsed and lose a dimension
-            level.usageAfter[connecting] = 0;
-        }
-    }
-
-    for (const auto& vertexUpdate : level.lodTetrahedrons)
-    {
-        vertices[vertexUpdate.tetrahedron.indices[0]] = vertexUpdate.next;
-    }
-    for (const auto& indexUpdate : level.lodLevelChanges)
-    {
-        tetrahedrons[indexUpdate.tetrahedronID].indices[indexUpdate.indexInTet] = indexUpdate.newIndex;
-    }
-
-    for (auto prey : preyTetrahedron)
+// Bounded refinement of the order of the last frame. The blocks of every second pass are shifted by half a block,
+// so tetrahedrons also cross the block borders
+inline void recordRefineSort(uint32_t n, vk::CommandBuffer buffer, IContext& context, vk::DescriptorBufferInfo sortBuffer, uint32_t passes) {
+    const auto flags = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
+    vk::BufferMemoryBarrier bufferMemoryBarrier(flags, flags, context.primaryFamilyIndex, context.primaryFamilyIndex, sortBuffer.buffer, sortBuffer.offset, sortBuffer.range);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeSortRefinePipeline);
+    for (uint32_t pass = 0; pass < passes; pass++)
     {
-        const auto& neighbours = lodGenerateInfo.graph[prey];
-        for (const auto& [neighbor, type] : neighbours) {
-            if (!level.usageAfter[neighbor]) continue;
-            std::span tetrahedron(tetrahedrons[neighbor].indices);
-            for (const auto& [other, otherType] : neighbours) {
-                if (!level.usageAfter[other] || neighbor == other) continue;
-                size_t amount = 0;
-                for (auto index : tetrahedrons[other].indices) {
-                    if (std::ranges::find(tetrahedron, index) == tetrahedron.end()) continue;
-                    amount++;
-                }
-                if (amount == 0)  continue;
-                if (amount > 3) {
-                    level.usageAfter[other] = 0;
-                }
-                auto& neighborList = lodGenerateInfo.graph[neighbor];
-                auto foundItem = std::ranges::find_if(neighborList, [=](auto& tuple) { return std::get<0>(tuple) == other;});
-                if (foundItem == std::end(neighborList)) {
-                    neighborList.emplace_back(other, (EdgeType)amount);
-                }
-                else {
-                    std::get<1>(*foundItem) = (EdgeType)amount;
-                }
-            }
-        }
-    }
-
-    if (level.lodTetrahedrons.empty()) {
-        std::cout << "Warning: No preys found for model " << lodGenerateInfo.name << " at level " << stringLODLevel(lodGenerateInfo.level) << std::endl;
-    }
-    else if (level.lodTetrahedrons.size() < COLAPSING_PER_LEVEL) {
-        std::cout << "Warning: Not enough preys found for model " << lodGenerateInfo.name << " at level " << stringLODLevel(lodGenerateInfo.level) << std::endl;
+        const uint32_t offset = (pass & 1) * SORT_LOCAL_ELEMENTS / 2;
+        if (n <= offset + 1) continue;
+        const std::array values = { SORT_REFINE_ROUNDS, offset };
+        buffer.pushConstants(context.defaultPipelineLayout, context.modelStages, offsetof(ModelPushConstants, k), 2 * sizeof(uint32_t), values.data());
+        const auto [groupsX, groupsY] = splitWorkGroups((n - offset + SORT_LOCAL_ELEMENTS - 1) / SORT_LOCAL_ELEMENTS);
+        buffer.dispatch(groupsX, groupsY, 1);
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
     }
-    return level;
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits::eDeviceGroup, {}, { bufferMemoryBarrier }, {});
 }
 
-VTKFile loadVTK(const std::string& vtkFile, IContext& context) {
-    std::ifstream valueVTK(vtkFile);
-    if (!valueVTK) throw std::runtime_error("Could not find file!");
-    std::string value;
-
-    std::vector<glm::vec4> vertices;
-    std::vector<Tetrahedron> tetrahedrons;
-    vertices.reserve(2048);
-    vertices.reserve(4096);
-
-    AABB aabb;
-    while (!valueVTK.eof() && valueVTK)
+// Same as RADIX_THREADS and RADIX_TILE in radix.comp
+constexpr uint32_t RADIX_THREADS = 256;
+constexpr uint32_t RADIX_TILE = 4 * RADIX_THREADS;
+constexpr uint32_t RADIX_PASSES = 4;
+
+// Depth key per tetrahedron, then four 8 bit scatter passes which end in the sort indices.
+// Camera and model have to be bound, context.radixScratch has to hold n elements
+inline void recordRadixSort(uint32_t n, vk::CommandBuffer buffer, IContext& context, SortType type) {
+    if (n == 0) return;
+    const auto& scratch = context.radixScratch;
+    const vk::MemoryBarrier toTransfer(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferWrite);
+    const vk::MemoryBarrier toCompute(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    const auto clear = [&](vk::DeviceSize offset, vk::DeviceSize size) {
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, toTransfer, {}, {});
+        buffer.fillBuffer(scratch.buffer, offset, size, 0);
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, toCompute, {}, {});
+    };
+    const auto radixPass = [&](vk::Pipeline pipeline, uint32_t pass, uint32_t groups) {
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        buffer.pushConstants(context.defaultPipelineLayout, context.modelStages, offsetof(ModelPushConstants, k), sizeof(uint32_t), &pass);
+        const auto [groupsX, groupsY] = splitWorkGroups(groups);
+        buffer.dispatch(groupsX, groupsY, 1);
+    };
+    buffer.pushConstants(context.defaultPipelineLayout, context.modelStages, offsetof(ModelPushConstants, scratch), sizeof(vk::DeviceAddress), &scratch.address);
+    clear(scratch.countersOffset, scratch.countersSize);
+    radixPass(type == SortType::RadixFarthest ? context.computeRadixKeyFarthestPipeline : context.computeRadixKeyPipeline,
+        0, (n + RADIX_THREADS - 1) / RADIX_THREADS);
+    for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
     {
-        valueVTK >> value;
-        if (value == "v") {
-            glm::vec4 vertex;
-            valueVTK >> vertex.x >> vertex.y >> vertex.z;
-            vertex.w = 1.0f;
-            vertices.push_back(vertex);
-            aabb.max = glm::max(aabb.max, glm::vec3(vertex));
-            aabb.min = glm::min(aabb.min, glm::vec3(vertex));
-        }
-        else if (value == "t") {
-            Tetrahedron tetrahedron;
-            valueVTK >> tetrahedron.indices[0] >> tetrahedron.indices[1] >>
-                tetrahedron.indices[2] >> tetrahedron.indices[3];
-            tetrahedrons.push_back(tetrahedron);
-        }
-        else {
-            assert(false);
-        }
+        clear(scratch.statusOffset, scratch.statusSize);
+        radixPass(context.computeRadixScatterPipeline, pass, (n + RADIX_TILE - 1) / RADIX_TILE);
     }
+    const vk::MemoryBarrier sorted(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, {}, sorted, {}, {});
+}
 
-#ifndef NDEBUG // Check if model is minimal
-    static constexpr float EPS = 1e-14f;
-    for (const auto& vertex : vertices)
-    {
-        size_t amount = 0;
-        for (const auto& other : vertices)
-        {
-            // check if near
-            bool all = true;
-            for (size_t i = 0; i < 4; i++)
-            {
-                if (std::abs(vertex[i] - other[i]) > EPS) {
-                    all = false;
-                    break;
-                }
-            }
-            if (all) amount++;
-        }
-        assert(amount == 1);
-    }
-#endif // NDEBUG
-
-    std::vector<std::vector<TetIndex>> vertexConnection(vertices.size());
-    for (auto& vec : vertexConnection) vec.reserve(64);
-    for (TetIndex i = 0; i < tetrahedrons.size(); i++)
-    {
-        const auto& tetrahedron = tetrahedrons[i];
-        for (size_t j = 0; j < 4; j++)
-            vertexConnection[tetrahedron.indices[j]].push_back(i);
-    }
+// Same as PROJECT_THREADS in project.comp
+constexpr uint32_t PROJECT_THREADS = 256;
 
-    TetGraph tetrahedronGraph(tetrahedrons.size());
-    for (auto& vec : tetrahedronGraph) vec.reserve(64);
-    std::vector<uint8_t> currentTetValues(tetrahedrons.size());
-    std::vector<TetIndex> addedValues;
-    addedValues.reserve(64);
-    size_t currentIndex = 0;
-    for (const auto& tet : tetrahedrons)
-    {
-        for (const auto dirtyValue : addedValues) {
-            currentTetValues[dirtyValue] = 0;
-        }
-        addedValues.clear();
+// Projects every vertex once and caches the outline of every tetrahedron for the bitonic sort and the task shader.
+// Waits for everything before it, the draws of the frame before still read the cache
+inline void recordProjection(const ModelBuffer& model, vk::CommandBuffer buffer, IContext& context) {
+    const auto vertexAmount = (uint32_t)(model.regions[0].size / sizeof(glm::vec4));
+    const auto tetrahedronAmount = (uint32_t)(model.regions[1].size / sizeof(Tetrahedron));
+    const auto flags = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
+    const vk::MemoryBarrier memoryBarrier(flags, flags);
+    const auto projectPass = [&](vk::Pipeline pipeline, uint32_t amount) {
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        const auto [groupsX, groupsY] = splitWorkGroups((amount + PROJECT_THREADS - 1) / PROJECT_THREADS);
+        buffer.dispatch(groupsX, groupsY, 1);
+    };
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    projectPass(context.computeProjectVerticesPipeline, vertexAmount);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    projectPass(context.computeProjectSilhouettesPipeline, tetrahedronAmount);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, {}, memoryBarrier, {}, {});
+}
 
-        for (size_t i = 0; i < 4; i++)
-        {
-            const auto value = tet.indices[i];
-            const auto& connected = vertexConnection[value];
-            for (const auto otherTetIndex : connected) {
-                if (otherTetIndex == currentIndex) continue;
-                const auto oldValue = currentTetValues[otherTetIndex];
-                if (oldValue == 0) addedValues.push_back(otherTetIndex);
-                currentTetValues[otherTetIndex] = oldValue + 1;
-            }
-        }
-        for (const auto index : addedValues)
-        {
-            const auto amount = currentTetValues[index];
-            assert(amount < 4);
-            auto& edgeList = tetrahedronGraph[currentIndex];
-            edgeList.emplace_back(index, (EdgeType)amount);
-        }
-        currentIndex++;
-    }
+// Same as CULL_THREADS in cull.comp
+constexpr uint32_t CULL_THREADS = 256;
 
-    static constexpr size_t SIDES_PER_TETRAHEDRON = 4;
-    std::vector<char> allowedToTake(tetrahedrons.size(), true);
-    // Finding outer tetrahedron and their direct neighbours
-    // Do not use as prey -> 3.4 Boundary preservation tests
-    for (size_t i = 0; i < tetrahedrons.size(); i++)
-    {
-        const auto& connected = tetrahedronGraph[i];
-        size_t amount = 0;
-        for (const auto& [other, type] : connected) {
-            if (type == EdgeType::Face) amount++;
-            if (amount == SIDES_PER_TETRAHEDRON) break;
-        }
-        if (amount == SIDES_PER_TETRAHEDRON) {
-            continue;
-        }
-        allowedToTake[i] = false;
-        for (const auto& [other, type] : connected) {
-            allowedToTake[other] = false;
-        }
-    }
+// Frustum test of every cluster for the task shader
+inline void recordClusterCulling(const ModelBuffer& model, vk::CommandBuffer buffer, IContext& context) {
+    const auto clusterAmount = (uint32_t)(model.regions[CLUSTER_BOUNDS_REGION].size / sizeof(ClusterBounds));
+    if (clusterAmount == 0) return;
+    const auto flags = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
+    const vk::MemoryBarrier memoryBarrier(flags, flags);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeCullPipeline);
+    const auto [groupsX, groupsY] = splitWorkGroups((clusterAmount + CULL_THREADS - 1) / CULL_THREADS);
+    buffer.dispatch(groupsX, groupsY, 1);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, {}, memoryBarrier, {}, {});
+}
 
-    std::array<LODLevel, LOD_COUNT> levelToGenerate;
-    levelToGenerate[0] = defaultLODLevel(context, tetrahedronGraph);
-    const size_t stateSize = (tetrahedrons.size() / sizeof(uint32_t) + 1) * sizeof(uint32_t);
-    size_t additionalDataSize = LOD_COUNT * stateSize;
-    auto modifiableLODVertex = vertices;
-    auto modifiableLODIndex = tetrahedrons;
-    for (size_t i = 1; i < LOD_COUNT; i++)
+// Same as LAYER_THREADS in layer.comp
+constexpr uint32_t LAYER_THREADS = 256;
+
+// Back to front order of the face graph in up to rounds layers, each one dispatched indirectly from the size of the one
+// before, which keeps the work near linear without reading anything back. Cycles and whatever is left after the last
+// round are appended unordered. Camera and model have to be bound, context.radixScratch has to hold n elements
+inline void recordLayerSort(uint32_t n, vk::CommandBuffer buffer, IContext& context, uint32_t rounds) {
+    if (n == 0) return;
+    const auto& scratch = context.radixScratch;
+    const vk::MemoryBarrier toTransfer(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferWrite);
+    const vk::MemoryBarrier toCompute(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    const vk::MemoryBarrier betweenStages(vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead);
+    const auto stageBarrier = [&]() {
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader
+            | vk::PipelineStageFlagBits::eDrawIndirect, {}, betweenStages, {}, {});
+    };
+    const auto perTetrahedron = [&](vk::Pipeline pipeline) {
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        const auto [groupsX, groupsY] = splitWorkGroups((n + LAYER_THREADS - 1) / LAYER_THREADS);
+        buffer.dispatch(groupsX, groupsY, 1);
+        stageBarrier();
+    };
+    buffer.pushConstants(context.defaultPipelineLayout, context.modelStages, offsetof(ModelPushConstants, scratch), sizeof(vk::DeviceAddress), &scratch.address);
+    // The layer state lives at the start of the histograms
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, toTransfer, {}, {});
+    buffer.fillBuffer(scratch.buffer, scratch.countersOffset, scratch.countersSize, 0);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, toCompute, {}, {});
+    perTetrahedron(context.computeLayerClassifyPipeline);
+    for (uint32_t round = 0; round < rounds; round++)
     {
-        LODGenerateInfo generateInfo{
-            levelToGenerate[i - 1].usageAfter, allowedToTake, levelToGenerate[i - 1].lodTetrahedrons, tetrahedronGraph, context,
-            (LodLevelFlag)i, Heuristic::Random, vtkFile };
-        levelToGenerate[i] = loadLODLevel(generateInfo, modifiableLODVertex, modifiableLODIndex);
-        additionalDataSize += levelToGenerate[i].lodTetrahedrons.size() * sizeof(LODTetrahedron);
-        additionalDataSize += levelToGenerate[i].lodLevelChanges.size() * sizeof(LODLevelChange);
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLayerPreparePipeline);
+        buffer.dispatch(1, 1, 1);
+        stageBarrier();
+        buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeLayerReleasePipeline);
+        buffer.dispatchIndirect(scratch.buffer, scratch.countersOffset);
+        stageBarrier();
     }
+    perTetrahedron(context.computeLayerRemainderPipeline);
+    const vk::MemoryBarrier sorted(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eAllCommands, {}, sorted, {}, {});
+}
 
-    const auto tetrahedronByteSize = tetrahedrons.size() * sizeof(Tetrahedron);
-    const auto vertexByteSize = vertices.size() * sizeof(glm::vec4);
-    const vk::BufferCreateInfo stagingBufferCreateInfo({},
-        vertexByteSize + tetrahedronByteSize + additionalDataSize, vk::BufferUsageFlagBits::eTransferSrc,
-        vk::SharingMode::eExclusive, context.primaryFamilyIndex);
-    const auto stagingBuffer = context.device.createBuffer(stagingBufferCreateInfo);
-    const ScopeExit cleanStagingBuffer([&]() { context.device.destroy(stagingBuffer); });
-
-    const auto memoryRequirementsStaging = context.device.getBufferMemoryRequirements(stagingBuffer);
-    const auto stagingMemory = context.requestMemory(memoryRequirementsStaging.size,
-        vk::MemoryPropertyFlagBits::eHostVisible);
-    const ScopeExit cleanStagingMemory([&]() { context.device.freeMemory(stagingMemory); });
-
-    void* mapped = context.device.mapMemory(stagingMemory, 0, VK_WHOLE_SIZE);
-    std::copy(vertices.begin(), vertices.end(), (glm::vec4*)mapped);
-    std::copy(tetrahedrons.begin(), tetrahedrons.end(), (Tetrahedron*)((char*)mapped + vertexByteSize));
-    char* nextPointer = ((char*)mapped + vertexByteSize + tetrahedronByteSize);
-    LODTetrahedron* nextPointerData = (LODTetrahedron*)(nextPointer + LOD_COUNT * stateSize);
-    for (const auto& lod : levelToGenerate) {
-        std::copy(lod.usageAfter.begin(), lod.usageAfter.end(), nextPointer);
-        std::copy(lod.lodTetrahedrons.begin(), lod.lodTetrahedrons.end(), nextPointerData);
-        nextPointer += stateSize;
-        nextPointerData += lod.lodTetrahedrons.size();
-    }
-    LODLevelChange* nextChanged = (LODLevelChange*)nextPointerData;
-    for (const auto& lod : levelToGenerate) {
-        std::copy(lod.lodLevelChanges.begin(), lod.lodLevelChanges.end(), nextChanged);
-        nextChanged += lod.lodLevelChanges.size();
-    }
-    context.device.unmapMemory(stagingMemory);
-    context.device.bindBufferMemory(stagingBuffer, stagingMemory, 0);
-
-    vk::BufferCreateInfo localBufferCreateInfo({},
-        0, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer
-        | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
-        vk::SharingMode::eExclusive, context.primaryFamilyIndex);
-    VTKBufferArray localBuffers;
-    VTKSizeArray sizesRequested = { vertexByteSize, tetrahedronByteSize,
-                    sizeof(uint32_t) * tetrahedrons.size() };
+inline VTKSizeArray requestedSizes(const MeshLayout& layout) {
+    VTKSizeArray sizesRequested = { layout.vertexByteSize(), layout.tetrahedronByteSize(),
+                    sizeof(uint32_t) * layout.tetrahedronAmount };
     for (size_t i = 3; i < LOD_COUNT + 3; i++) {
-        sizesRequested[i] = stateSize;
-        const auto& current = levelToGenerate[i - 3];
-        sizesRequested[i + LOD_COUNT] = current.lodTetrahedrons.size() * sizeof(LODTetrahedron);
-        sizesRequested[i + LOD_COUNT * 2] = current.lodLevelChanges.size() * sizeof(LODLevelChange);
+        sizesRequested[i] = layout.stateSize();
+        sizesRequested[i + LOD_COUNT] = layout.lodAmount[i - 3] * sizeof(LODTetrahedron);
+        sizesRequested[i + LOD_COUNT * 2] = layout.lodUpdateAmount[i - 3] * sizeof(LODLevelChange);
     }
+    sizesRequested[FACE_REGION] = layout.faceNeighbourByteSize();
+    sizesRequested[CLUSTER_BOUNDS_REGION] = layout.clusterBoundsByteSize();
+    sizesRequested[CLUSTER_REGION] = layout.clusterByteSize();
+    sizesRequested[SCREEN_VERTEX_REGION] = layout.vertexByteSize();
+    sizesRequested[SILHOUETTE_REGION] = layout.tetrahedronAmount * sizeof(Silhouette);
+    sizesRequested[CLUSTER_VISIBILITY_REGION] = layout.clusterAmount * sizeof(uint32_t);
+    return sizesRequested;
+}
 
-    VTKSizeArray sizesActual;
-    size_t totalSizeRequested = 0;
+// One device local buffer holding every non empty array at an aligned offset, with packedModels
+// the header with the array addresses comes first and has to be uploaded with uploadModelHeader
+inline ModelBuffer createModelBuffer(IContext& context, const VTKSizeArray& sizesRequested) {
+    ModelBuffer model;
+    const auto alignment = std::max<vk::DeviceSize>(16u, context.storageAlignment);
+    vk::DeviceSize size = context.packedModels ? sizeof(ModelHeader) : 0;
     for (size_t i = 0; i < sizesRequested.size(); i++)
     {
         if (sizesRequested[i] == 0) continue;
-        localBufferCreateInfo.size = sizesRequested[i];
-        const auto localBuffer = context.device.createBuffer(localBufferCreateInfo);
-        const auto requirements = context.device.getBufferMemoryRequirements(localBuffer);
-        const auto localSize = (requirements.size / requirements.alignment + 1) * requirements.alignment;
-        totalSizeRequested += localSize;
-        sizesActual[i] = localSize;
-        localBuffers[i] = localBuffer;
+        model.regions[i].offset = (size + alignment - 1) / alignment * alignment;
+        model.regions[i].size = sizesRequested[i];
+        size = model.regions[i].offset + sizesRequested[i];
     }
 
-    const auto actualeMemory = context.requestMemory(totalSizeRequested,
-        vk::MemoryPropertyFlagBits::eDeviceLocal);
+    // Transfer source for readbackVisibilityMesh
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer
+        | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eVertexBuffer;
+    if (context.packedModels) usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    const vk::BufferCreateInfo bufferCreateInfo({}, size, usage, vk::SharingMode::eExclusive, context.primaryFamilyIndex);
+    model.buffer = context.device.createBuffer(bufferCreateInfo);
+    model.memory = context.requestMemory(context.device.getBufferMemoryRequirements(model.buffer), vk::MemoryPropertyFlagBits::eDeviceLocal);
+    context.device.bindBufferMemory(model.buffer, model.memory.memory, model.memory.offset);
+    if (context.packedModels)
+        model.header = context.device.getBufferAddress(vk::BufferDeviceAddressInfo(model.buffer));
+    return model;
+}
 
-    size_t currentOffset = 0;
-    for (size_t i = 0; i < localBuffers.size(); i++)
-    {
-        if (sizesRequested[i] == 0) continue;
-        context.device.bindBufferMemory(localBuffers[i], actualeMemory, currentOffset);
-        currentOffset += sizesActual[i];
-    }
+inline void uploadModelHeader(IContext& context, const ModelBuffer& model, uint32_t tetrahedronAmount) {
+    ModelHeader header{};
+    for (size_t i = 0; i < model.regions.size(); i++)
+        if (model.regions[i].size != 0) header.regions[i] = model.header + model.regions[i].offset;
+    for (size_t i = 4; i < 3 + LOD_COUNT; i++)
+        if (header.regions[i] == 0) header.regions[i] = header.regions[3];
+    header.tetrahedronAmount = tetrahedronAmount;
+    header.vertexAmount = (uint32_t)(model.regions[0].size / sizeof(glm::vec4));
+    header.clusterAmount = (uint32_t)(model.regions[CLUSTER_BOUNDS_REGION].size / sizeof(ClusterBounds));
+    uploadToBuffer(context, model.buffer, 0, &header, sizeof(header));
+}
 
+// Levels without an own visibility buffer fall back to the one of LOD 0. Not needed with packedModels
+inline VTKDescriptorArray createVTKDescriptors(IContext& context, const ModelBuffer& model) {
+    if (context.packedModels) return {};
     std::array<vk::DescriptorSetLayout, 1 + LOD_COUNT> descriptorsToAllocate = { context.defaultDescriptorSetLayout };
     for (size_t i = 1; i < descriptorsToAllocate.size(); i++)
     {
@@ -521,92 +365,64 @@ VTKFile loadVTK(const std::string& vtkFile, IContext& context) {
     const vk::DescriptorSetAllocateInfo allocateInfo(context.descriptorPool, descriptorsToAllocate);
     const auto descriptor = context.device.allocateDescriptorSets(allocateInfo);
     const vk::DescriptorBufferInfo descriptorCameraInfo(context.uniformCamera, 0, VK_WHOLE_SIZE);
-    const vk::DescriptorBufferInfo descriptorVertexInfo(localBuffers[0], 0, VK_WHOLE_SIZE);
-    const vk::DescriptorBufferInfo descriptorIndexInfo(localBuffers[1], 0, VK_WHOLE_SIZE);
-    const vk::DescriptorBufferInfo descriptorNumberInfo(localBuffers[2], 0, VK_WHOLE_SIZE);
+    const auto descriptorVertexInfo = model.info(0);
+    const auto descriptorIndexInfo = model.info(1);
+    const auto descriptorNumberInfo = model.info(2);
+    const auto descriptorScreenVertexInfo = model.info(SCREEN_VERTEX_REGION);
+    const auto descriptorSilhouetteInfo = model.info(SILHOUETTE_REGION);
+    const auto descriptorClusterBoundsInfo = model.info(CLUSTER_BOUNDS_REGION);
+    const auto descriptorClusterInfo = model.info(CLUSTER_REGION);
+    const auto descriptorClusterVisibilityInfo = model.info(CLUSTER_VISIBILITY_REGION);
     const vk::WriteDescriptorSet writeCameraSets(descriptor[0], 0, 0, vk::DescriptorType::eUniformBuffer, {}, descriptorCameraInfo);
     const vk::WriteDescriptorSet writeIndexDescriptorSets(descriptor[0], 1, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorIndexInfo);
     const vk::WriteDescriptorSet writeVertexDescriptorSets(descriptor[0], 2, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorVertexInfo);
     const vk::WriteDescriptorSet writeSortIndexDescriptorSets(descriptor[0], 3, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorNumberInfo);
+    const vk::WriteDescriptorSet writeScreenVertexDescriptorSets(descriptor[0], 4, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorScreenVertexInfo);
+    const vk::WriteDescriptorSet writeSilhouetteDescriptorSets(descriptor[0], 5, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorSilhouetteInfo);
+    const vk::WriteDescriptorSet writeClusterBoundsDescriptorSets(descriptor[0], 6, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorClusterBoundsInfo);
+    const vk::WriteDescriptorSet writeClusterDescriptorSets(descriptor[0], 7, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorClusterInfo);
+    const vk::WriteDescriptorSet writeClusterVisibilityDescriptorSets(descriptor[0], 8, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorClusterVisibilityInfo);
     // LOD Descriptor
-    const vk::DescriptorBufferInfo descriptorLOD0(localBuffers[3], 0, VK_WHOLE_SIZE);
+    const auto descriptorLOD0 = model.info(3);
     const vk::WriteDescriptorSet writeLOD0DescriptorSets(descriptor[1], 1, 0, vk::DescriptorType::eStorageBuffer, {}, descriptorLOD0);
     std::array<vk::DescriptorBufferInfo, (LOD_COUNT - 1) * 3> lodBufferInfos;
-    std::vector writeUpdateInfos = { writeCameraSets, writeIndexDescriptorSets,  writeVertexDescriptorSets, writeSortIndexDescriptorSets, writeLOD0DescriptorSets };
+    std::vector writeUpdateInfos = { writeCameraSets, writeIndexDescriptorSets,  writeVertexDescriptorSets, writeSortIndexDescriptorSets,
+        writeScreenVertexDescriptorSets, writeSilhouetteDescriptorSets, writeClusterBoundsDescriptorSets, writeClusterDescriptorSets,
+        writeClusterVisibilityDescriptorSets, writeLOD0DescriptorSets };
     for (size_t i = 0; i < LOD_COUNT - 1; i++)
     {
         const auto currentDescriptor = descriptor[2 + i];
-        const auto visibilityBuffer = localBuffers[4 + i];
-        if (visibilityBuffer) {
+        const auto visibilityRegion = model.regions[4 + i].size != 0 ? 4 + i : 3;
+        if (model.regions[visibilityRegion].size != 0) {
             auto& visibility = lodBufferInfos[i];
-            visibility = vk::DescriptorBufferInfo{ visibilityBuffer, 0, VK_WHOLE_SIZE };
+            visibility = model.info(visibilityRegion);
             const vk::WriteDescriptorSet writeVisibility(currentDescriptor, 1, 0, vk::DescriptorType::eStorageBuffer, {}, visibility);
             writeUpdateInfos.push_back(writeVisibility);
         }
 
-        const auto dataBuffer = localBuffers[i + LOD_COUNT + 4];
-        if (dataBuffer) {
+        const auto dataRegion = i + LOD_COUNT + 4;
+        if (model.regions[dataRegion].size != 0) {
             auto& tetrahedrons = lodBufferInfos[i + LOD_COUNT - 1];
-            tetrahedrons = vk::DescriptorBufferInfo{ dataBuffer , 0, VK_WHOLE_SIZE };
+            tetrahedrons = model.info(dataRegion);
             const vk::WriteDescriptorSet writeData(currentDescriptor, 0, 0, vk::DescriptorType::eStorageBuffer, {}, tetrahedrons);
             writeUpdateInfos.push_back(writeData);
         }
 
-        const auto dataChangeBuffer = localBuffers[i + LOD_COUNT * 2 + 4];
-        if (dataChangeBuffer) {
+        const auto dataChangeRegion = i + LOD_COUNT * 2 + 4;
+        if (model.regions[dataChangeRegion].size != 0) {
             auto& tetrahedrons = lodBufferInfos[i + LOD_COUNT * 2 - 2];
-            tetrahedrons = vk::DescriptorBufferInfo{ dataChangeBuffer , 0, VK_WHOLE_SIZE };
+            tetrahedrons = model.info(dataChangeRegion);
             const vk::WriteDescriptorSet writeData(currentDescriptor, 2, 0, vk::DescriptorType::eStorageBuffer, {}, tetrahedrons);
             writeUpdateInfos.push_back(writeData);
         }
     }
     context.device.updateDescriptorSets(writeUpdateInfos, {});
 
-    const std::array descriptorsWithZeroLOD = { descriptor[0], descriptor[1] };
-
-    auto [commandBuffer, fence] = context.commandBuffer.get<DataCommandBuffer::DataUpload>();
-    vk::CommandBufferBeginInfo beginInfo;
-    commandBuffer.begin(beginInfo);
-    const vk::BufferCopy copyBuffer(0, 0, vertexByteSize);
-    commandBuffer.copyBuffer(stagingBuffer, localBuffers[0], copyBuffer);
-    const vk::BufferCopy copyBufferIndex(vertexByteSize, 0, tetrahedronByteSize);
-    commandBuffer.copyBuffer(stagingBuffer, localBuffers[1], copyBufferIndex);
-
-    vk::BufferCopy copyVisibility(tetrahedronByteSize + vertexByteSize, 0, stateSize);
-    vk::BufferCopy copyLODData(tetrahedronByteSize + vertexByteSize + LOD_COUNT * stateSize);
-
-    size_t visible = 0;
-    for (const auto& lod : levelToGenerate) {
-        commandBuffer.copyBuffer(stagingBuffer, localBuffers[3 + visible], copyVisibility);
-        const auto sizeOfData = lod.lodTetrahedrons.size() * sizeof(LODTetrahedron);
-        if (sizeOfData != 0) {
-            copyLODData.size = sizeOfData;
-            commandBuffer.copyBuffer(stagingBuffer, localBuffers[3 + LOD_COUNT + visible], copyLODData);
-        }
-        visible++;
-        copyVisibility.srcOffset += stateSize;
-        copyLODData.srcOffset += sizeOfData;
-    }
-
-    vk::BufferCopy copyLODChangeData(copyLODData.srcOffset);
-    for (const auto& lod : levelToGenerate) {
-        const auto sizeOfData = lod.lodLevelChanges.size() * sizeof(LODLevelChange);
-        if (sizeOfData != 0) {
-            copyLODChangeData.size = sizeOfData;
-            commandBuffer.copyBuffer(stagingBuffer, localBuffers[3 + LOD_COUNT + visible], copyLODChangeData);
-        }
-        visible++;
-        copyLODChangeData.srcOffset += sizeOfData;
-    }
-
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, context.defaultPipelineLayout, 0, descriptorsWithZeroLOD, {});
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeInitPipeline);
-    commandBuffer.dispatch(1, 1, 1);
-    commandBuffer.end();
-    auto queue = context.device.getQueue(context.primaryFamilyIndex, 0);
-    const vk::SubmitInfo submitInfo({}, {}, commandBuffer);
-    queue.submit(submitInfo, fence);
+    return descriptor;
+}
 
+inline std::pair<vk::CommandPool, vk::CommandBuffer> recordVTKSortSecondary(IContext& context, const ModelBuffer& model,
+    const VTKDescriptorArray& descriptor, uint32_t amountOfTetrahedrons) {
     const vk::CommandPoolCreateInfo commandPoolCreate({}, context.primaryFamilyIndex);
     const auto pool = context.device.createCommandPool(commandPoolCreate);
 
@@ -614,23 +430,578 @@ VTKFile loadVTK(const std::string& vtkFile, IContext& context) {
     const auto buffer = context.device.allocateCommandBuffers(commandAllocateInfo)[0];
 
     vk::CommandBufferInheritanceInfo inheritanceInfo(context.renderPass, 0);
+    // Executed by the primary buffer of every frame in flight
+    vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
     beginInfo.setPInheritanceInfo(&inheritanceInfo);
     buffer.begin(beginInfo);
-    buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, context.defaultPipelineLayout, 0u, descriptorsWithZeroLOD, {});
-    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeSortPipeline);
-    recordBitonicSort(tetrahedrons.size(), buffer, context, localBuffers[2]);
+    bindCamera(context, buffer, vk::PipelineBindPoint::eCompute);
+    bindModel(context, buffer, vk::PipelineBindPoint::eCompute, model, descriptor, 0);
+    recordBitonicSort(amountOfTetrahedrons, buffer, context, model.info(2));
     buffer.end();
+    return { pool, buffer };
+}
+
+// Source files above fileSizeThreshold are streamed instead of being loaded into host memory at once.
+// The mesh chunks and both adjacency sorts each get a third of memoryBudget, staging uses the upload ring
+struct StreamingSettings {
+    uint64_t fileSizeThreshold = 2ull << 30;
+    size_t memoryBudget = 256ull << 20;
+    // Empty means the temporary directory of the system
+    std::filesystem::path temporaryDirectory;
+};
+
+// Graphics side of a model upload: acquires the uploaded buffers and initialises the sort indices,
+// visibleState is filled with ones and every tetrahedron put into cluster 0 when it is set. The fence signals
+// once the model can be drawn
+inline std::pair<vk::CommandPool, vk::Fence> submitVTKInitialisation(IContext& context, const ModelBuffer& model, const VTKDescriptorArray& descriptor,
+    bool fillVisibleState = false) {
+    // Own pool and fence, several uploads can be in flight at once
+    const vk::CommandPoolCreateInfo commandPoolCreate(vk::CommandPoolCreateFlagBits::eTransient, context.primaryFamilyIndex);
+    const auto pool = context.device.createCommandPool(commandPoolCreate);
+    const vk::CommandBufferAllocateInfo commandAllocateInfo(pool, vk::CommandBufferLevel::ePrimary, 1);
+    const auto commandBuffer = context.device.allocateCommandBuffers(commandAllocateInfo)[0];
+    const auto fence = context.device.createFence({});
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    const auto uploadValue = acquireUploads(context, commandBuffer);
+    if (fillVisibleState) {
+        commandBuffer.fillBuffer(model.buffer, model.regions[3].offset, model.regions[3].size, 0x01010101u);
+        commandBuffer.fillBuffer(model.buffer, model.regions[CLUSTER_REGION].offset, model.regions[CLUSTER_REGION].size, 0u);
+    }
+    bindCamera(context, commandBuffer, vk::PipelineBindPoint::eCompute);
+    bindModel(context, commandBuffer, vk::PipelineBindPoint::eCompute, model, descriptor, 0);
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, context.computeInitPipeline);
+    // iota.comp strides over the rest, 128 invocations per workgroup
+    const auto sortAmount = (uint32_t)(model.regions[2].size / sizeof(uint32_t));
+    commandBuffer.dispatch(std::clamp((sortAmount + 127) / 128, 1u, 65535u), 1, 1);
+    commandBuffer.end();
+    submitAfterUploads(context, commandBuffer, uploadValue, fence);
+    return { pool, fence };
+}
+
+
+// Everything of loadVTK which touches neither the queue nor a pool, so it can run on any thread:
+// parsing or the cache lookup and creating the device local buffers
+struct PreparedMesh {
+    MeshLayout layout;
+    bool streaming = false;
+    std::unique_ptr<MappedFile> cache;
+    std::vector<char> generatedData;
+    ModelBuffer model;
+    std::string source;
 
-    VTKFile file{ tetrahedrons.size(), actualeMemory, localBuffers, pool, buffer, descriptor, aabb };
-    for (const auto& level : levelToGenerate)
+    // Data in the staging layout described by MeshLayout
+    const char* stagingData() const { return cache ? cache->data + sizeof(MeshCacheHeader) : generatedData.data(); }
+};
+
+inline PreparedMesh prepareMesh(const std::string& vtkFile, IContext& context, const StreamingSettings& streaming = {}) {
+    PreparedMesh prepared;
+    const auto startTimePreparing = std::chrono::steady_clock::now();
+    const auto expectedHeader = meshCacheHeader(vtkFile);
+    if (expectedHeader.sourceSize > streaming.fileSizeThreshold) {
+        prepared.streaming = true;
+        return prepared;
+    }
+    prepared.cache = openMeshCache(vtkFile, expectedHeader);
+    auto& layout = prepared.layout;
+    if (prepared.cache) {
+        layout = cacheHeader(*prepared.cache).layout;
+    }
+    else {
+        prepared.generatedData = generateMeshCache(vtkFile, expectedHeader, layout);
+    }
+    const auto durationPreparing = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimePreparing);
+    std::cout << "Preparing time " << durationPreparing.count() / (1e6f) << " ms for " << vtkFile
+        << (prepared.cache ? " (cache hit)" : " (cache miss)") << std::endl;
+
+    prepared.source = vtkFile;
+    prepared.model = createModelBuffer(context, requestedSizes(layout));
+    return prepared;
+}
+
+// Copies a prepared mesh into the upload ring, several meshes are batched until the next flush
+inline void stageUpload(const PreparedMesh& prepared, IContext& context) {
+    const auto& layout = prepared.layout;
+    const auto& model = prepared.model;
+    const auto upload = [&](size_t region, const char* data) {
+        if (model.regions[region].size != 0) uploadToBuffer(context, model.buffer, model.regions[region].offset, data, model.regions[region].size);
+        return data + model.regions[region].size;
+    };
+    if (context.packedModels) uploadModelHeader(context, model, (uint32_t)layout.tetrahedronAmount);
+    // The staging layout is the region order without the sort indices and the projection
+    const char* data = prepared.stagingData();
+    data = upload(0, data);
+    data = upload(1, data);
+    for (size_t i = 3; i < SCREEN_VERTEX_REGION; i++)
+        data = upload(i, data);
+}
+
+// Submitted upload of a prepared mesh, file can be drawn once fence signaled
+struct PendingUpload {
+    VTKFile file;
+    vk::CommandPool pool;
+    vk::Fence fence;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Has to run on the thread owning the queues and the descriptor pool, after stageUpload of the mesh
+inline PendingUpload submitUpload(const PreparedMesh& prepared, IContext& context) {
+    const auto& layout = prepared.layout;
+    const auto& model = prepared.model;
+    const auto descriptor = createVTKDescriptors(context, model);
+    const auto [uploadPool, fence] = submitVTKInitialisation(context, model, descriptor);
+    const auto [pool, buffer] = recordVTKSortSecondary(context, model, descriptor, (uint32_t)layout.tetrahedronAmount);
+
+    PendingUpload upload{ VTKFile{ (size_t)layout.tetrahedronAmount, model, pool, buffer, descriptor, layout.aabb },
+        uploadPool, fence };
+    upload.file.lodAmount.assign(layout.lodAmount.begin(), layout.lodAmount.end());
+    upload.file.lodUpdateAmount.assign(layout.lodUpdateAmount.begin(), layout.lodUpdateAmount.end());
+    upload.file.source = prepared.source;
+    return upload;
+}
+
+inline bool uploadFinished(IContext& context, const PendingUpload& upload) {
+    const auto result = context.device.getFenceStatus(upload.fence);
+    if (result == vk::Result::eNotReady)
+        return false;
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("Vulkan Error");
+    return true;
+}
+
+// Frees everything only needed during the upload, the fence must have signaled
+inline VTKFile finishUpload(IContext& context, const PendingUpload& upload) {
+    context.device.destroy(upload.fence);
+    context.device.destroy(upload.pool);
+    reclaimUploads(context, false);
+    return upload.file;
+}
+
+inline void printUploadTime(const std::string& vtkFile, const PendingUpload& upload) {
+    const auto durationUpload = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - upload.start);
+    std::cout << "Upload time " << durationUpload.count() / (1e6f) << " ms for " << vtkFile << std::endl;
+}
+
+// A model streamed chunk by chunk through the upload ring into the device local buffers, host memory stays
+// within settings.memoryBudget. There is no LOD in this mode, it needs the whole tetrahedron graph in memory.
+// The vertices of a tetrahedron chunk are already gone, so the whole model is a single cluster.
+// Reading touches no queue and may run on a worker, uploading and submitting the chunks has to run on the
+// thread owning the queues
+struct StreamedMesh {
+    std::string source;
+    std::unique_ptr<MeshChunkReader> reader;
+    MeshLayout layout;
+    ModelBuffer model;
+    uint64_t boundaryFaces = 0;
+    // Advanced by uploadStreamedChunk
+    uint64_t vertexOffset = 0;
+    uint64_t tetrahedronOffset = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+inline StreamedMesh openStreamedMesh(const std::string& vtkFile, IContext& context) {
+    StreamedMesh mesh;
+    mesh.start = std::chrono::steady_clock::now();
+    mesh.source = vtkFile;
+    mesh.reader = std::make_unique<MeshChunkReader>(vtkFile);
+    if (mesh.reader->tetrahedronAmount >= std::numeric_limits<TetIndex>::max())
+        throw std::runtime_error("Too many tetrahedrons for 32 bit indices!");
+    auto& layout = mesh.layout;
+    layout.vertexAmount = mesh.reader->vertexAmount;
+    layout.tetrahedronAmount = mesh.reader->tetrahedronAmount;
+    layout.clusterAmount = 1;
+    auto sizesRequested = requestedSizes(layout);
+    // Only the visibility of LOD 0, the other levels fall back to it
+    std::fill(sizesRequested.begin() + 4, sizesRequested.begin() + 3 + LOD_COUNT, 0);
+    mesh.model = createModelBuffer(context, sizesRequested);
+    return mesh;
+}
+
+// Hands every chunk to consume, which may take its contents. The face adjacency is built out of core
+// and written to <mesh>.adjacency afterwards. The mesh chunks and both adjacency sorts each get a third of memoryBudget
+template<typename F>
+inline void readStreamedChunks(StreamedMesh& mesh, const StreamingSettings& settings, F&& consume) {
+    auto& layout = mesh.layout;
+    const size_t budgetPart = settings.memoryBudget / 3;
+    const auto temporaryDirectory = settings.temporaryDirectory.empty() ? std::filesystem::temp_directory_path() : settings.temporaryDirectory;
+    ExternalSorter<FaceRecord> faces(temporaryDirectory, budgetPart);
+
+    static_assert(sizeof(glm::vec4) == sizeof(Tetrahedron));
+    const size_t maxElements = std::max<size_t>(1u, budgetPart / sizeof(glm::vec4));
+    MeshData chunk;
+    uint64_t tetrahedronOffset = 0;
+    while (mesh.reader->next(chunk, maxElements)) {
+        for (TetIndex i = 0; i < chunk.tetrahedrons.size(); i++)
+        {
+            for (const auto index : chunk.tetrahedrons[i].indices)
+                if (index >= layout.vertexAmount) throw std::runtime_error("Vertex index out of range in mesh file!");
+            pushFaces(faces, chunk.tetrahedrons[i], (TetIndex)(tetrahedronOffset + i));
+        }
+        layout.aabb = extendAABB(layout.aabb, chunk.aabb);
+        tetrahedronOffset += chunk.tetrahedrons.size();
+        consume(chunk);
+    }
+    mesh.reader.reset();
+
+    const auto durationStreaming = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mesh.start);
+    std::cout << "Streaming time " << durationStreaming.count() / (1e6f) << " ms for " << mesh.source << " (" << layout.vertexAmount
+        << " vertices, " << layout.tetrahedronAmount << " tetrahedrons)" << std::endl;
+
+    // Runs on the CPU while the last uploads are still in flight
+    const auto startTimeAdjacency = std::chrono::steady_clock::now();
+    mesh.boundaryFaces = writeFaceAdjacency(faces, layout.tetrahedronAmount, mesh.source + ".adjacency", temporaryDirectory, budgetPart);
+    const auto durationAdjacency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeAdjacency);
+    std::cout << "Adjacency time " << durationAdjacency.count() / (1e6f) << " ms for " << mesh.source << " ("
+        << mesh.boundaryFaces << " boundary faces)" << std::endl;
+}
+
+// The copies run while the next chunk is read
+inline void uploadStreamedChunk(IContext& context, StreamedMesh& mesh, const MeshData& chunk) {
+    const auto& model = mesh.model;
+    uploadToBuffer(context, model.buffer, model.regions[0].offset + mesh.vertexOffset * sizeof(glm::vec4), chunk.vertices.data(), chunk.vertices.size() * sizeof(glm::vec4));
+    uploadToBuffer(context, model.buffer, model.regions[1].offset + mesh.tetrahedronOffset * sizeof(Tetrahedron), chunk.tetrahedrons.data(), chunk.tetrahedrons.size() * sizeof(Tetrahedron));
+    flushUploads(context);
+    mesh.vertexOffset += chunk.vertices.size();
+    mesh.tetrahedronOffset += chunk.tetrahedrons.size();
+}
+
+// Uploads the face adjacency and the cluster bounds once every chunk was read and uploaded
+inline PendingUpload submitStreamedMesh(IContext& context, const StreamedMesh& mesh, const StreamingSettings& settings) {
+    const auto& layout = mesh.layout;
+    const auto& model = mesh.model;
+    const auto descriptor = createVTKDescriptors(context, model);
+    if (context.packedModels) uploadModelHeader(context, model, (uint32_t)layout.tetrahedronAmount);
+    // Same layout as the face neighbour region, only the order within a row differs
     {
-        file.lodAmount.push_back(level.lodTetrahedrons.size());
-        file.lodUpdateAmount.push_back(level.lodLevelChanges.size());
+        std::ifstream adjacency(mesh.source + ".adjacency", std::ios::binary);
+        std::vector<char> piece(settings.memoryBudget / 3 / 16 * 16 + 16);
+        for (vk::DeviceSize done = 0; done < layout.faceNeighbourByteSize();) {
+            const auto size = std::min<vk::DeviceSize>(piece.size(), layout.faceNeighbourByteSize() - done);
+            if (!adjacency.read(piece.data(), size)) throw std::runtime_error("Could not read adjacency file!");
+            uploadToBuffer(context, model.buffer, model.regions[FACE_REGION].offset + done, piece.data(), size);
+            done += size;
+        }
     }
-    const auto result = context.device.waitForFences(fence, true, std::numeric_limits<uint64_t>().max());
+    const ClusterBounds bounds{ glm::vec4(layout.aabb.min, 1.0f), glm::vec4(layout.aabb.max, 1.0f) };
+    uploadToBuffer(context, model.buffer, model.regions[CLUSTER_BOUNDS_REGION].offset, &bounds, sizeof(bounds));
+    // Every tetrahedron starts visible
+    const auto [uploadPool, fence] = submitVTKInitialisation(context, model, descriptor, true);
+    const auto [pool, buffer] = recordVTKSortSecondary(context, model, descriptor, (uint32_t)layout.tetrahedronAmount);
+
+    PendingUpload upload{ VTKFile{ (size_t)layout.tetrahedronAmount, model, pool, buffer, descriptor, layout.aabb },
+        uploadPool, fence, mesh.start };
+    upload.file.lodAmount.assign(LOD_COUNT, 0);
+    upload.file.lodUpdateAmount.assign(LOD_COUNT, 0);
+    return upload;
+}
+
+// Frees the model of a mesh which failed to load, together with its copies which were never acquired
+inline void discardModel(IContext& context, ModelBuffer& model) {
+    discardUploads(context, model.buffer);
+    model.destroy(context);
+}
+
+inline VTKFile loadVTKStreaming(const std::string& vtkFile, IContext& context, const StreamingSettings& settings) {
+    auto mesh = openStreamedMesh(vtkFile, context);
+    PendingUpload upload;
+    try {
+        readStreamedChunks(mesh, settings, [&](const MeshData& chunk) { uploadStreamedChunk(context, mesh, chunk); });
+        upload = submitStreamedMesh(context, mesh, settings);
+    }
+    catch (const std::exception&) {
+        discardModel(context, mesh.model);
+        throw;
+    }
+    const auto result = context.device.waitForFences(upload.fence, true, std::numeric_limits<uint64_t>().max());
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("Vulkan Error");
     std::cout << "Loaded model: " << vtkFile << std::endl;
+    return finishUpload(context, upload);
+}
+
+VTKFile loadVTK(const std::string& vtkFile, IContext& context, const StreamingSettings& streaming = {}) {
+    const auto prepared = prepareMesh(vtkFile, context, streaming);
+    if (prepared.streaming)
+        return loadVTKStreaming(vtkFile, context, streaming);
+    const auto startTimeUpload = std::chrono::steady_clock::now();
+    stageUpload(prepared, context);
+    auto upload = submitUpload(prepared, context);
+    upload.start = startTimeUpload;
+    const auto result = context.device.waitForFences(upload.fence, true, std::numeric_limits<uint64_t>().max());
     if (result != vk::Result::eSuccess)
         throw std::runtime_error("Vulkan Error");
+    printUploadTime(vtkFile, upload);
+    std::cout << "Loaded model: " << vtkFile << std::endl;
+    return finishUpload(context, upload);
+}
+
+// Copies the vertices, tetrahedrons and face neighbours of a model back from the device, for models whose mesh cache
+// is gone. Only call while the device is idle, the copy holds the LOD state of the last frame
+inline std::shared_ptr<VisibilityMesh> readbackVisibilityMesh(IContext& context, const VTKFile& vtk) {
+    const std::array regions = { size_t(0), size_t(1), FACE_REGION };
+    vk::DeviceSize size = 0;
+    std::vector<vk::BufferCopy> copies;
+    for (const auto region : regions)
+    {
+        copies.emplace_back(vtk.data.regions[region].offset, size, vtk.data.regions[region].size);
+        size += vtk.data.regions[region].size;
+    }
+    const vk::BufferCreateInfo bufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive, context.primaryFamilyIndex);
+    const auto staging = context.device.createBuffer(bufferCreateInfo);
+    const auto stagingMemory = context.requestMemory(context.device.getBufferMemoryRequirements(staging),
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    const ScopeExit cleanStaging([&]() { context.device.destroy(staging); context.releaseMemory(stagingMemory); });
+    context.device.bindBufferMemory(staging, stagingMemory.memory, stagingMemory.offset);
+
+    const auto [buffer, fence] = context.commandBuffer.get<DataCommandBuffer::DataUpload>();
+    buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    buffer.copyBuffer(vtk.data.buffer, staging, copies);
+    const vk::MemoryBarrier toHost(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, toHost, {}, {});
+    buffer.end();
+    std::array buffers = { buffer };
+    vk::SubmitInfo submitInfo({}, {}, buffers, {});
+    context.primaryQueue.submit(submitInfo, fence);
+    const auto result = context.device.waitForFences(fence, true, std::numeric_limits<uint64_t>().max());
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("Wait for fence failed!");
     context.device.resetFences(fence);
-    return file;
+
+    auto mesh = std::make_shared<VisibilityMesh>();
+    const auto vertices = (const glm::vec4*)stagingMemory.mapped;
+    mesh->vertices.assign(vertices, vertices + copies[0].size / sizeof(glm::vec4));
+    const auto tetrahedrons = (const Tetrahedron*)(stagingMemory.mapped + copies[1].dstOffset);
+    mesh->tetrahedrons.assign(tetrahedrons, tetrahedrons + vtk.amountOfTetrahedrons);
+    const auto neighbours = (const std::array<TetIndex, 4>*)(stagingMemory.mapped + copies[2].dstOffset);
+    mesh->neighbours.assign(neighbours, neighbours + copies[2].size / sizeof(std::array<TetIndex, 4>));
+    return mesh;
 }
+
+// Builds the CPU copies of the face graph order the first time it is chosen and frees them once another order
+// is in use, so models do not keep their mesh in host memory for nothing. Returns true if any model changed
+inline bool updateVisibilityMeshes(IContext& context, std::vector<std::optional<VTKFile>>& files, bool needed) {
+    bool changed = false;
+    bool idle = false;
+    for (auto& file : files)
+    {
+        if (!file || file->source.empty() || (bool)file->visibility == needed) continue;
+        changed = true;
+        if (!needed) {
+            file->visibility.reset();
+            continue;
+        }
+        try {
+            file->visibility = loadVisibilityMesh(file->source);
+        }
+        catch (const std::exception&) {
+            // Source is gone, the device still has the mesh
+        }
+        if (file->visibility) continue;
+        if (!idle) context.device.waitIdle();
+        idle = true;
+        file->visibility = readbackVisibilityMesh(context, *file);
+    }
+    return changed;
+}
+
+// Prepares models on a pool of worker threads while the caller keeps rendering. poll() must be called
+// by the thread owning the queues, it submits the prepared uploads and hands out the finished models.
+// Streamed models are read on a worker as well, poll() uploads their chunks as they arrive
+struct ModelLoader {
+    // Chunks of a streamed model on their way from the worker to poll(). The worker waits while one is queued,
+    // the queued chunk takes the third of memoryBudget the adjacency sort only needs after reading
+    struct Stream {
+        StreamedMesh mesh;
+        std::mutex mutex;
+        std::condition_variable space;
+        std::deque<MeshData> chunks;
+        bool done = false;
+        bool cancelled = false;
+        std::string error;
+
+        void cancel() {
+            {
+                std::lock_guard lock(mutex);
+                cancelled = true;
+            }
+            space.notify_all();
+        }
+    };
+
+    IContext& context;
+    std::vector<std::string> vtkFiles;
+    StreamingSettings streaming;
+    std::vector<char> failed;
+    size_t remaining;
+
+    std::atomic<size_t> nextModel = 0;
+    std::atomic<bool> stop = false;
+    std::mutex preparedMutex;
+    std::vector<std::pair<size_t, PreparedMesh>> prepared;
+    std::vector<std::pair<size_t, std::shared_ptr<Stream>>> startedStreams;
+    std::vector<std::pair<size_t, std::string>> errors;
+    std::vector<std::pair<size_t, std::shared_ptr<Stream>>> streams;
+    std::vector<std::pair<size_t, PendingUpload>> uploads;
+    std::vector<std::thread> workers;
+
+    ModelLoader(IContext& context, std::vector<std::string> files, const StreamingSettings& streaming = {})
+        : context(context), vtkFiles(std::move(files)), streaming(streaming), failed(vtkFiles.size(), false), remaining(vtkFiles.size()) {
+        const size_t workerAmount = std::min(amountOfWorkers(), vtkFiles.size());
+        for (size_t i = 0; i < workerAmount; i++)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    ~ModelLoader() {
+        {
+            std::lock_guard lock(preparedMutex);
+            stop = true;
+            for (auto& [index, stream] : startedStreams)
+                stream->cancel();
+        }
+        for (auto& [index, stream] : streams)
+            stream->cancel();
+        for (auto& worker : workers)
+            worker.join();
+        for (auto& [index, mesh] : prepared)
+            mesh.model.destroy(context);
+        streams.insert(streams.end(), startedStreams.begin(), startedStreams.end());
+        for (auto& [index, stream] : streams)
+            discardModel(context, stream->mesh.model);
+        for (auto& [index, upload] : uploads) {
+            (void)context.device.waitForFences(upload.fence, true, std::numeric_limits<uint64_t>().max());
+            finishUpload(context, upload).unload(context);
+        }
+    }
+
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    bool finished() const { return remaining == 0; }
+
+    // Returns (index into vtkFiles, model) for every upload which finished since the last call
+    std::vector<std::pair<size_t, VTKFile>> poll() {
+        std::vector<std::pair<size_t, PreparedMesh>> newlyPrepared;
+        std::vector<std::pair<size_t, std::string>> newErrors;
+        {
+            std::lock_guard lock(preparedMutex);
+            newlyPrepared.swap(prepared);
+            newErrors.swap(errors);
+            streams.insert(streams.end(), startedStreams.begin(), startedStreams.end());
+            startedStreams.clear();
+        }
+        for (const auto& [index, error] : newErrors)
+            fail(index, error);
+
+        std::vector<std::pair<size_t, VTKFile>> loaded;
+        // All models prepared since the last call share the transfer submits
+        const auto startTimeUpload = std::chrono::steady_clock::now();
+        std::erase_if(newlyPrepared, [&](auto& entry) {
+            try {
+                stageUpload(entry.second, context);
+                return false;
+            }
+            catch (const std::exception& exception) {
+                fail(entry.first, exception.what());
+                discardModel(context, entry.second.model);
+                return true;
+            }
+            });
+        for (auto& [index, mesh] : newlyPrepared) {
+            try {
+                uploads.emplace_back(index, submitUpload(mesh, context));
+                uploads.back().second.start = startTimeUpload;
+            }
+            catch (const std::exception& exception) {
+                fail(index, exception.what());
+                discardModel(context, mesh.model);
+            }
+        }
+        std::erase_if(streams, [&](const auto& entry) { return pollStream(entry.first, *entry.second); });
+        std::erase_if(uploads, [&](const auto& upload) {
+            if (!uploadFinished(context, upload.second)) return false;
+            printUploadTime(vtkFiles[upload.first], upload.second);
+            std::cout << "Loaded model: " << vtkFiles[upload.first] << std::endl;
+            loaded.emplace_back(upload.first, finishUpload(context, upload.second));
+            return true;
+            });
+        remaining -= loaded.size();
+        return loaded;
+    }
+
+private:
+    void fail(size_t index, const std::string& error) {
+        std::cout << "Warning: Could not load model " << vtkFiles[index] << ": " << error << std::endl;
+        failed[index] = true;
+        remaining--;
+    }
+
+    // Uploads the chunks read so far, returns true once the stream was submitted or failed
+    bool pollStream(size_t index, Stream& stream) {
+        std::deque<MeshData> chunks;
+        bool done;
+        std::string error;
+        {
+            std::lock_guard lock(stream.mutex);
+            chunks.swap(stream.chunks);
+            done = stream.done;
+            error = stream.error;
+        }
+        stream.space.notify_all();
+        try {
+            if (!error.empty()) throw std::runtime_error(error);
+            for (const auto& chunk : chunks)
+                uploadStreamedChunk(context, stream.mesh, chunk);
+            if (!done) return false;
+            uploads.emplace_back(index, submitStreamedMesh(context, stream.mesh, streaming));
+        }
+        catch (const std::exception& exception) {
+            // The worker may still be reading, it only touches the reader and the layout
+            stream.cancel();
+            fail(index, exception.what());
+            discardModel(context, stream.mesh.model);
+        }
+        return true;
+    }
+
+    void readStream(Stream& stream) {
+        try {
+            readStreamedChunks(stream.mesh, streaming, [&](MeshData& chunk) {
+                std::unique_lock lock(stream.mutex);
+                stream.space.wait(lock, [&]() { return stream.chunks.empty() || stream.cancelled; });
+                if (stream.cancelled) throw std::runtime_error("Loading cancelled!");
+                stream.chunks.push_back(std::move(chunk));
+                });
+        }
+        catch (const std::exception& exception) {
+            std::lock_guard lock(stream.mutex);
+            stream.error = exception.what();
+        }
+        std::lock_guard lock(stream.mutex);
+        stream.done = true;
+    }
+
+    void work() {
+        for (size_t index = nextModel++; index < vtkFiles.size() && !stop; index = nextModel++)
+        {
+            std::shared_ptr<Stream> stream;
+            try {
+                auto mesh = prepareMesh(vtkFiles[index], context, streaming);
+                if (mesh.streaming) {
+                    stream = std::make_shared<Stream>();
+                    stream->mesh = openStreamedMesh(vtkFiles[index], context);
+                }
+                std::lock_guard lock(preparedMutex);
+                if (stream) startedStreams.emplace_back(index, stream);
+                else prepared.emplace_back(index, std::move(mesh));
+                // Started after the destructor cancelled the others, it discards this one unread
+                if (stop) stream.reset();
+            }
+            catch (const std::exception& exception) {
+                std::lock_guard lock(preparedMutex);
+                errors.emplace_back(index, exception.what());
+                continue;
+            }
+            if (stream) readStream(*stream);
+        }
+    }
+};
@@ -0,0 +1,211 @@
+#include "Util.hpp"
+#include "MeshCore.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Runs the CPU stages of loadVTK, the visibility order, the LOD chain and the clusters one by one, no Vulkan device is created.
+// Usage: MeshBenchmark [--max-tets N] [--heuristic random|volume] [--selection greedy|independent] [mesh files...]
+// Without files the shipped assets and generated grids from 10k to 10M tetrahedrons are used
+
+inline size_t peakMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Cube grid with every cube split into the six tetrahedrons along its main diagonal,
+// written as a binary legacy VTK file so parsing is part of the measurement
+inline void writeGridMesh(const std::filesystem::path& file, size_t cubesPerAxis) {
+    const size_t pointsPerAxis = cubesPerAxis + 1;
+    const auto pointIndex = [=](size_t x, size_t y, size_t z) { return (uint32_t)((z * pointsPerAxis + y) * pointsPerAxis + x); };
+    const auto bigEndian = [](uint32_t value) { return std::endian::native == std::endian::little ? byteSwap(value) : value; };
+
+    std::ofstream output(file, std::ios::binary);
+    if (!output) throw std::runtime_error("Could not create benchmark mesh!");
+    const size_t pointAmount = pointsPerAxis * pointsPerAxis * pointsPerAxis;
+    output << "# vtk DataFile Version 3.0\nMeshBenchmark grid\nBINARY\nDATASET UNSTRUCTURED_GRID\nPOINTS " << pointAmount << " float\n";
+    std::vector<uint32_t> values;
+    values.reserve(pointsPerAxis * pointsPerAxis * 3);
+    for (size_t z = 0; z < pointsPerAxis; z++)
+    {
+        values.clear();
+        for (size_t y = 0; y < pointsPerAxis; y++)
+            for (size_t x = 0; x < pointsPerAxis; x++)
+                for (const auto coordinate : { x, y, z })
+                    values.push_back(bigEndian(std::bit_cast<uint32_t>((float)coordinate / cubesPerAxis)));
+        output.write((const char*)values.data(), values.size() * sizeof(uint32_t));
+    }
+
+    static constexpr std::array<std::array<size_t, 3>, 6> AXIS_ORDERS = { {
+        { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } } };
+    const size_t cellAmount = cubesPerAxis * cubesPerAxis * cubesPerAxis * AXIS_ORDERS.size();
+    output << "\nCELLS " << cellAmount << " " << cellAmount * 5 << "\n";
+    for (size_t z = 0; z < cubesPerAxis; z++)
+    {
+        values.clear();
+        for (size_t y = 0; y < cubesPerAxis; y++)
+        {
+            for (size_t x = 0; x < cubesPerAxis; x++)
+            {
+                for (const auto& order : AXIS_ORDERS)
+                {
+                    std::array<size_t, 3> corner = { x, y, z };
+                    values.push_back(bigEndian(4));
+                    values.push_back(bigEndian(pointIndex(corner[0], corner[1], corner[2])));
+                    for (const auto axis : order)
+                    {
+                        corner[axis]++;
+                        values.push_back(bigEndian(pointIndex(corner[0], corner[1], corner[2])));
+                    }
+                }
+            }
+        }
+        output.write((const char*)values.data(), values.size() * sizeof(uint32_t));
+    }
+
+    output << "\nCELL_TYPES " << cellAmount << "\n";
+    values.assign(cubesPerAxis * cubesPerAxis * AXIS_ORDERS.size(), bigEndian(VTK_TETRA));
+    for (size_t i = 0; i < cubesPerAxis * cubesPerAxis * cubesPerAxis * AXIS_ORDERS.size(); i += values.size())
+        output.write((const char*)values.data(), values.size() * sizeof(uint32_t));
+    output << "\n";
+}
+
+inline void printStage(const char* stage, std::chrono::nanoseconds duration, size_t tetrahedrons) {
+    const auto seconds = duration.count() / 1e9;
+    std::cout << "  " << std::left << std::setw(10) << stage << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+        << seconds * 1e3 << " ms" << std::setw(16) << std::setprecision(0) << (seconds > 0 ? tetrahedrons / seconds : 0.0) << " tets/s" << std::endl;
+}
+
+inline void benchmarkMesh(const std::string& file, Heuristic heuristic, PreySelection selection) {
+    using Clock = std::chrono::steady_clock;
+    std::cout << file << std::endl;
+
+    auto start = Clock::now();
+    MeshData mesh = parseMesh(file);
+    const size_t tetrahedrons = mesh.tetrahedrons.size();
+    printStage("parse", Clock::now() - start, tetrahedrons);
+
+    start = Clock::now();
+    weldVertices(mesh);
+    printStage("weld", Clock::now() - start, tetrahedrons);
+
+    start = Clock::now();
+    LODWorkspace workspace;
+    workspace.incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+    TetGraph graph = buildTetGraph(mesh.tetrahedrons, workspace.incidence);
+    printStage("graph", Clock::now() - start, tetrahedrons);
+
+    start = Clock::now();
+    const auto collapsible = findCollapsible(graph);
+    printStage("boundary", Clock::now() - start, tetrahedrons);
+
+    // Visibility order from outside the bounding box, against a centroid depth sort as the per tetrahedron key sorts do it
+    start = Clock::now();
+    const auto neighbours = buildFaceNeighbours(mesh.tetrahedrons, workspace.incidence);
+    printStage("faces", Clock::now() - start, tetrahedrons);
+    const glm::vec3 eye = mesh.aabb.max + (mesh.aabb.max - mesh.aabb.min) * 0.5f;
+    VisibilityWorkspace visibilityWorkspace;
+    std::vector<TetIndex> order(tetrahedrons);
+    start = Clock::now();
+    const auto stats = visibilityOrder(mesh.vertices, mesh.tetrahedrons, neighbours, eye, visibilityWorkspace, order);
+    printStage("order", Clock::now() - start, tetrahedrons);
+    const auto orderViolations = countOrderViolations(mesh.vertices, mesh.tetrahedrons, neighbours, eye, order);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<float> depth(tetrahedrons);
+    start = Clock::now();
+    for (size_t i = 0; i < tetrahedrons; i++)
+        depth[i] = centroidDistance(mesh.vertices, mesh.tetrahedrons[i], eye);
+    std::ranges::sort(order, [&](TetIndex a, TetIndex b) { return depth[a] > depth[b]; });
+    printStage("depth", Clock::now() - start, tetrahedrons);
+    const auto depthViolations = countOrderViolations(mesh.vertices, mesh.tetrahedrons, neighbours, eye, order);
+    std::cout << "  " << stats.cycleBreaks << " cycles broken, " << orderViolations << " face violations with order, "
+        << depthViolations << " with depth" << std::endl;
+
+    start = Clock::now();
+    const auto levels = generateLODChain(mesh, graph, workspace, collapsible, file, heuristic, selection);
+    printStage("lod", Clock::now() - start, tetrahedrons);
+
+    start = Clock::now();
+    const auto clusters = buildClusters(mesh.vertices, mesh.tetrahedrons, mesh.aabb, levels);
+    printStage("clusters", Clock::now() - start, tetrahedrons);
+
+    size_t collapsed = 0;
+    for (const auto& level : levels)
+        collapsed += level.lodTetrahedrons.size();
+    std::cout << "  " << tetrahedrons << " tetrahedrons, " << mesh.vertices.size() << " vertices, " << collapsed
+        << " collapses, " << clusters.bounds.size() << " clusters, peak memory " << peakMemory() / (1024 * 1024) << " MiB" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t maxTetrahedrons = 10'000'000;
+    Heuristic heuristic = Heuristic::VolumeError;
+    PreySelection selection = PreySelection::IndependentSet;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+        if (argument == "--max-tets" && i + 1 < argc) maxTetrahedrons = std::stoull(argv[++i]);
+        else if (argument == "--heuristic" && i + 1 < argc)
+            heuristic = std::string_view(argv[++i]) == "random" ? Heuristic::Random : Heuristic::VolumeError;
+        else if (argument == "--selection" && i + 1 < argc)
+            selection = std::string_view(argv[++i]) == "greedy" ? PreySelection::Greedy : PreySelection::IndependentSet;
+        else files.emplace_back(argument);
+    }
+
+    try {
+        if (!files.empty()) {
+            for (const auto& file : files)
+                benchmarkMesh(file, heuristic, selection);
+            return 0;
+        }
+
+        if (std::filesystem::is_directory("assets")) {
+            for (const auto& entry : std::filesystem::directory_iterator("assets"))
+            {
+                const auto extension = entry.path().extension();
+                if (extension == ".vtk" || extension == ".tet")
+                    benchmarkMesh(entry.path().string(), heuristic, selection);
+            }
+        }
+
+        const auto directory = std::filesystem::temp_directory_path() / "MeshBenchmark";
+        std::filesystem::create_directories(directory);
+        const ScopeExit cleanup([&]() { std::error_code error; std::filesystem::remove_all(directory, error); });
+        for (const size_t target : { 10'000ull, 100'000ull, 1'000'000ull, 10'000'000ull })
+        {
+            if (target > maxTetrahedrons) break;
+            const auto cubesPerAxis = (size_t)std::ceil(std::cbrt(target / 6.0));
+            const auto file = directory / ("grid" + std::to_string(target) + ".vtk");
+            writeGridMesh(file, cubesPerAxis);
+            benchmarkMesh(file.string(), heuristic, selection);
+            std::filesystem::remove(file);
+        }
+    }
+    catch (const std::exception& exception) {
+        std::cerr << "Benchmark failed: " << exception.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
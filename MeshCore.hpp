@@ -0,0 +1,2246 @@
+#pragma once
+
+// CPU side of the mesh pipeline: parsing, adjacency, boundary detection, the LOD chain and the
+// .tetbin cache. Depends on glm and the standard library only, so it builds without Vulkan or a window
+
+#include <vector>
+#include <array>
+#include <string>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <fstream>
+#include <bitset>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cfloat>
+#include <cassert>
+#include <filesystem>
+#include <memory>
+#include <bit>
+#include <numeric>
+#include <string_view>
+#include <atomic>
+#include <queue>
+#include <optional>
+#include <functional>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <span>
+#include <unordered_map>
+#include <algorithm>
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "Util.hpp"
+
+using VertIndex = uint32_t;
+
+struct Tetrahedron {
+    VertIndex indices[4];
+};
+using TetIndex = uint32_t;
+
+enum class EdgeType : uint32_t {
+   None = 0, Point = 1, Edge = 2, Face = 3, OverPromotion = 4
+};
+
+struct Connection {
+    TetIndex tetrahedron;
+    EdgeType type;
+};
+
+// Neighbourhood of every tetrahedron in compressed sparse row form, row i is
+// connections[offsets[i], offsets[i + 1]).
+// Connections found after building (through collapses) go into a per row overflow list
+struct TetGraph {
+    std::vector<uint64_t> offsets;
+    std::vector<Connection> connections;
+    std::unordered_map<TetIndex, std::vector<Connection>> overflow;
+
+    struct Row {
+        std::span<Connection> packed;
+        std::vector<Connection>* extra = nullptr;
+
+        struct Iterator {
+            const Row* row;
+            size_t index;
+            Connection& operator*() const {
+                return index < row->packed.size() ? row->packed[index] : (*row->extra)[index - row->packed.size()];
+            }
+            Iterator& operator++() { index++; return *this; }
+            bool operator==(const Iterator& other) const { return index == other.index; }
+        };
+
+        size_t size() const { return packed.size() + (extra ? extra->size() : 0); }
+        Iterator begin() const { return { this, 0 }; }
+        Iterator end() const { return { this, size() }; }
+    };
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+    Row operator[](TetIndex tetrahedron) {
+        std::span<Connection> packed(connections.data() + offsets[tetrahedron], connections.data() + offsets[tetrahedron + 1]);
+        if (!overflow.empty()) {
+            const auto found = overflow.find(tetrahedron);
+            if (found != overflow.end()) return { packed, &found->second };
+        }
+        return { packed, nullptr };
+    }
+
+    // Existing connections are updated in place through a row, other has to be new to this one
+    void append(TetIndex tetrahedron, TetIndex other, EdgeType type) {
+        overflow[tetrahedron].push_back({ other, type });
+    }
+
+    size_t memoryUsage() const {
+        size_t bytes = offsets.capacity() * sizeof(uint64_t) + connections.capacity() * sizeof(Connection);
+        for (const auto& [tetrahedron, extra] : overflow)
+            bytes += extra.capacity() * sizeof(Connection) + sizeof(extra) + sizeof(tetrahedron);
+        return bytes;
+    }
+};
+
+// Tetrahedra using a vertex, one entry per use. Rows start out in compressed sparse row form,
+// a row moves into the relocated map the first time a collapse changes it
+struct VertexIncidence {
+    std::vector<uint64_t> offsets;
+    std::vector<TetIndex> tetrahedrons;
+    std::unordered_map<VertIndex, std::vector<TetIndex>> relocated;
+
+    std::span<const TetIndex> operator[](VertIndex vertex) const {
+        if (!relocated.empty()) {
+            const auto found = relocated.find(vertex);
+            if (found != relocated.end()) return found->second;
+        }
+        return { tetrahedrons.data() + offsets[vertex], tetrahedrons.data() + offsets[vertex + 1] };
+    }
+
+    void move(TetIndex tetrahedron, VertIndex from, VertIndex to) {
+        auto& fromRow = relocatedRow(from);
+        const auto found = std::ranges::find(fromRow, tetrahedron);
+        assert(found != fromRow.end());
+        fromRow.erase(found);
+        relocatedRow(to).push_back(tetrahedron);
+    }
+
+private:
+    std::vector<TetIndex>& relocatedRow(VertIndex vertex) {
+        const auto [found, inserted] = relocated.try_emplace(vertex);
+        if (inserted) found->second.assign(tetrahedrons.begin() + offsets[vertex], tetrahedrons.begin() + offsets[vertex + 1]);
+        return found->second;
+    }
+};
+
+inline VertexIncidence buildVertexIncidence(const std::vector<Tetrahedron>& tetrahedrons, size_t vertexAmount) {
+    VertexIncidence incidence;
+    incidence.offsets.assign(vertexAmount + 1, 0);
+    for (const auto& tetrahedron : tetrahedrons)
+        for (const auto vertex : tetrahedron.indices)
+            incidence.offsets[vertex + 1]++;
+    std::partial_sum(incidence.offsets.begin(), incidence.offsets.end(), incidence.offsets.begin());
+    incidence.tetrahedrons.resize(incidence.offsets.back());
+    auto cursor = incidence.offsets;
+    for (TetIndex i = 0; i < tetrahedrons.size(); i++)
+        for (const auto vertex : tetrahedrons[i].indices)
+            incidence.tetrahedrons[cursor[vertex]++] = i;
+    return incidence;
+}
+
+struct AABB {
+    glm::vec3 min{ FLT_MAX };
+    glm::vec3 max{ -FLT_MAX };
+};
+
+inline AABB extendAABB(const AABB& aabb1, const AABB& aabb2) {
+    return { glm::min(aabb1.min, aabb2.min), glm::max(aabb1.max, aabb2.max) };
+}
+
+struct LODTetrahedron {
+    glm::vec4 previous[4];
+    glm::vec4 next;
+    Tetrahedron tetrahedron;
+};
+
+struct LODLevelChange {
+    uint32_t indexInTet;
+    uint32_t oldIndex;
+    uint32_t newIndex;
+    uint32_t tetrahedronID;
+};
+
+struct LODLevel {
+    std::vector<LODTetrahedron> lodTetrahedrons;
+    std::vector<LODLevelChange> lodLevelChanges;
+    std::vector<char> usageAfter;
+};
+constexpr size_t COLAPSING_PER_LEVEL = 250u;
+
+enum class LodLevelFlag {
+    None, L1, L2, L3, L4, L5, L6, L7, L8
+};
+constexpr size_t LOD_COUNT = 8;
+enum class Heuristic {
+    Random, VolumeError
+};
+enum class PreySelection {
+    Greedy, IndependentSet
+};
+inline std::string stringLODLevel(const LodLevelFlag flag) {
+    switch (flag)
+    {
+    case LodLevelFlag::None: return "None";
+    case LodLevelFlag::L1: return "L1";
+    case LodLevelFlag::L2: return "L2";
+    case LodLevelFlag::L3: return "L3";
+    case LodLevelFlag::L4: return "L4";
+    case LodLevelFlag::L5: return "L5";
+    case LodLevelFlag::L6: return "L6";
+    case LodLevelFlag::L7: return "L7";
+    case LodLevelFlag::L8: return "L8";
+
+    default:
+        throw std::runtime_error("Wrong LODLevelFlag!");
+    }
+}
+
+// Shared vertex of a point neighbour and its index in that neighbour
+using ConnectingPoint = std::pair<TetIndex, uint32_t>;
+
+struct SelectedPrey {
+    TetIndex tetrahedron;
+    glm::vec4 midPoint;
+    size_t pointOffset;
+};
+
+// Kept across all levels of a mesh so a level only touches what its collapses changed
+struct LODWorkspace {
+    VertexIncidence incidence;
+    // Blocked for the current level if equal to epoch, a new level only increments epoch
+    std::vector<uint32_t> blocked;
+    uint32_t epoch = 0;
+    // Shared vertex counts, every user resets the entries it touched
+    std::vector<uint8_t> shared;
+    std::vector<TetIndex> touched;
+    // Highest rank around a tetrahedron while selecting an independent set, reset by every round
+    std::vector<uint32_t> best;
+    std::vector<SelectedPrey> selected;
+    std::vector<ConnectingPoint> selectedPoints;
+};
+
+struct CollapseCandidate {
+    float cost;
+    TetIndex tetrahedron;
+    uint32_t version;
+
+    bool operator>(const CollapseCandidate& other) const {
+        return cost != other.cost ? cost > other.cost : tetrahedron > other.tetrahedron;
+    }
+};
+
+// Cheapest collapse first, kept across all levels of a mesh. Entries are never removed,
+// they turn stale when the version of their tetrahedron was bumped by a cost update
+struct CollapseQueue {
+    std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, std::greater<>> queue;
+    std::vector<uint32_t> versions;
+    std::vector<char> dirty;
+    // Signed volume of every tetrahedron, refreshed for the neighbours of every collapse
+    std::vector<float> volumes;
+};
+
+struct LODGenerateInfo {
+    const std::vector<char>& previous;
+    const std::vector<char>& outer;
+    const std::vector<LODTetrahedron>& previousTets;
+    TetGraph& graph;
+    LODWorkspace& workspace;
+    LodLevelFlag level;
+    Heuristic heuristic;
+    std::string name;
+    PreySelection selection = PreySelection::Greedy;
+    CollapseQueue* collapseQueue = nullptr;
+};
+
+inline LODLevel defaultLODLevel(const TetGraph& graph) {
+    LODLevel level;
+    level.usageAfter.resize(graph.size(), true);
+    return level;
+}
+
+inline glm::vec4 barycentre(const std::vector<glm::vec4>& vertices, const Tetrahedron& tetrahedron) {
+    glm::vec4 all(0);
+    for (size_t i = 0; i < 4; i++)
+    {
+        all += vertices[tetrahedron.indices[i]];
+    }
+    return all / 4.0f;
+}
+
+// Returns true if moving the prey to its barycentre flips a point neighbour,
+// otherwise connectingPoint holds the shared vertex of every point neighbour
+inline bool collapseFlips(const LODGenerateInfo& lodGenerateInfo, TetIndex preyIndex, const glm::vec3 midPoint,
+    const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons, std::span<ConnectingPoint> connectingPoint) {
+    const auto& prey = tetrahedrons[preyIndex];
+    const std::span preySpan = prey.indices;
+    size_t indexOfNeighbour = 0;
+    for (const auto& [connecting, type] : lodGenerateInfo.graph[preyIndex])
+    {
+        indexOfNeighbour++;
+        if (type != EdgeType::Point) continue;
+        if (!lodGenerateInfo.previous[connecting]) continue;
+        const auto& other = tetrahedrons[connecting];
+        std::array<VertIndex, 3> usedForPlane;
+        size_t amountFound = 0;
+        VertIndex otherPoint;
+        VertIndex otherIndex;
+        for (size_t i = 0; i < 4; i++)
+        {
+            const auto index = other.indices[i];
+            if (std::ranges::find(preySpan, index) != preySpan.end()) {
+                otherPoint = index;
+                otherIndex = i;
+                continue;
+            }
+            assert(amountFound < 3);
+            usedForPlane[amountFound++] = index;
+        }
+        assert(amountFound == 3);
+        connectingPoint[indexOfNeighbour - 1] = { otherPoint, otherIndex };
+        // Test plane for flips
+        const auto& point2 = vertices[usedForPlane[0]];
+        const glm::vec3 v0 = vertices[usedForPlane[1]] - point2;
+        const glm::vec3 v1 = vertices[usedForPlane[2]] - point2;
+        assert(v0 != glm::vec3(0));
+        assert(v1 != glm::vec3(0));
+        const auto planeNormal = glm::normalize(glm::cross(v0, v1));
+        const glm::vec3 oldVertex = vertices[otherPoint] - point2;
+        assert(oldVertex != glm::vec3(0));
+        const auto signOld = glm::sign(glm::dot(planeNormal, oldVertex));
+        const auto signNew = glm::sign(glm::dot(planeNormal, midPoint - glm::vec3(point2)));
+        if (signOld != signNew) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Still part of the previous level and not next to a prey of the current one
+inline bool isAvailable(const LODGenerateInfo& lodGenerateInfo, TetIndex tetrahedron) {
+    return lodGenerateInfo.previous[tetrahedron] && lodGenerateInfo.workspace.blocked[tetrahedron] != lodGenerateInfo.workspace.epoch;
+}
+
+// No other prey of the same level may touch a neighbour of this one
+inline void blockNeighbourhood(TetGraph& graph, LODWorkspace& workspace, TetIndex preyIndex) {
+    workspace.blocked[preyIndex] = workspace.epoch;
+    for (const auto& [connecting, type] : graph[preyIndex])
+    {
+        workspace.blocked[connecting] = workspace.epoch;
+        for (const auto& [secondDegreeNeighbor, t] : graph[connecting]) {
+            workspace.blocked[secondDegreeNeighbor] = workspace.epoch;
+        }
+    }
+}
+
+inline float signedVolume(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+    return glm::dot(b - a, glm::cross(c - a, d - a)) / 6.0f;
+}
+
+inline float tetrahedronVolume(const std::vector<glm::vec4>& vertices, const Tetrahedron& tetrahedron) {
+    const auto& i = tetrahedron.indices;
+    return signedVolume(vertices[i[0]], vertices[i[1]], vertices[i[2]], vertices[i[3]]);
+}
+
+// Volume changed by collapsing the prey into its barycentre: the prey and every neighbour
+// sharing an edge or face vanish, neighbours sharing a point get that point moved
+inline float collapseVolumeError(TetGraph& graph, const std::vector<char>& present, TetIndex preyIndex,
+    const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons, const std::vector<float>& volumes) {
+    const auto& prey = tetrahedrons[preyIndex];
+    const glm::vec3 midPoint = barycentre(vertices, prey);
+    float error = std::abs(volumes[preyIndex]);
+    for (const auto& [connecting, type] : graph[preyIndex])
+    {
+        if (!present[connecting]) continue;
+        const auto volume = volumes[connecting];
+        if (type != EdgeType::Point) {
+            error += std::abs(volume);
+            continue;
+        }
+        const auto& other = tetrahedrons[connecting];
+        std::array<glm::vec3, 4> moved;
+        for (size_t i = 0; i < 4; i++)
+        {
+            const auto index = other.indices[i];
+            moved[i] = std::ranges::find(prey.indices, index) != std::end(prey.indices) ? midPoint : glm::vec3(vertices[index]);
+        }
+        error += std::abs(signedVolume(moved[0], moved[1], moved[2], moved[3]) - volume);
+    }
+    return error;
+}
+
+// Costs every candidate on the first level, later levels keep the queue of the one before
+inline CollapseQueue& preparedCollapseQueue(const LODGenerateInfo& lodGenerateInfo, const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons) {
+    if (!lodGenerateInfo.collapseQueue) throw std::runtime_error("Volume error heuristic needs a collapse queue!");
+    auto& collapseQueue = *lodGenerateInfo.collapseQueue;
+    auto& graph = lodGenerateInfo.graph;
+    if (!collapseQueue.versions.empty()) return collapseQueue;
+    collapseQueue.versions.assign(graph.size(), 0);
+    collapseQueue.dirty.assign(graph.size(), 0);
+    collapseQueue.volumes.resize(graph.size());
+    std::vector<float> costs(graph.size());
+    parallelFor(graph.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            collapseQueue.volumes[i] = tetrahedronVolume(vertices, tetrahedrons[i]);
+    });
+    parallelFor(graph.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!lodGenerateInfo.outer[i] || !lodGenerateInfo.previous[i]) continue;
+            costs[i] = collapseVolumeError(graph, lodGenerateInfo.previous, (TetIndex)i, vertices, tetrahedrons, collapseQueue.volumes);
+        }
+    });
+    std::vector<CollapseCandidate> candidates;
+    for (size_t i = 0; i < graph.size(); i++)
+        if (lodGenerateInfo.outer[i] && lodGenerateInfo.previous[i]) candidates.push_back({ costs[i], (TetIndex)i, 0 });
+    collapseQueue.queue = decltype(collapseQueue.queue)(std::greater<>(), std::move(candidates));
+    return collapseQueue;
+}
+
+// Pops candidates cheapest first. Blocked ones go back for the next level, flipping ones only
+// return once their neighbourhood changed and their cost was updated
+inline void selectCheapestPreys(const LODGenerateInfo& lodGenerateInfo, const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons) {
+    auto& selected = lodGenerateInfo.workspace.selected;
+    auto& selectedPoints = lodGenerateInfo.workspace.selectedPoints;
+    auto& collapseQueue = preparedCollapseQueue(lodGenerateInfo, vertices, tetrahedrons);
+    auto& graph = lodGenerateInfo.graph;
+
+    std::vector<CollapseCandidate> blocked;
+    while (!collapseQueue.queue.empty() && selected.size() < COLAPSING_PER_LEVEL)
+    {
+        const auto candidate = collapseQueue.queue.top();
+        collapseQueue.queue.pop();
+        const auto preyIndex = candidate.tetrahedron;
+        if (candidate.version != collapseQueue.versions[preyIndex] || !lodGenerateInfo.previous[preyIndex]) continue;
+        if (!isAvailable(lodGenerateInfo, preyIndex)) {
+            blocked.push_back(candidate);
+            continue;
+        }
+        const auto midPoint = barycentre(vertices, tetrahedrons[preyIndex]);
+        const auto pointOffset = selectedPoints.size();
+        selectedPoints.resize(pointOffset + graph[preyIndex].size());
+        const std::span connectingPoint(selectedPoints.data() + pointOffset, selectedPoints.data() + selectedPoints.size());
+        if (collapseFlips(lodGenerateInfo, preyIndex, midPoint, vertices, tetrahedrons, connectingPoint)) {
+            selectedPoints.resize(pointOffset);
+            continue;
+        }
+        selected.push_back({ preyIndex, midPoint, pointOffset });
+        blockNeighbourhood(graph, lodGenerateInfo.workspace, preyIndex);
+    }
+    for (const auto& candidate : blocked)
+        collapseQueue.queue.push(candidate);
+}
+
+// A cost depends on the prey and its neighbours, so only candidates up to two connections
+// away from a collapse need a new one
+inline void updateCollapseCosts(const LODGenerateInfo& lodGenerateInfo, const std::vector<char>& present, std::span<const SelectedPrey> selected,
+    const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons) {
+    auto& collapseQueue = *lodGenerateInfo.collapseQueue;
+    auto& graph = lodGenerateInfo.graph;
+    std::vector<TetIndex> changed;
+    // Only tetrahedrons sharing a vertex with a prey had a vertex moved
+    for (const auto& selectedPrey : selected)
+        for (const auto& [connecting, type] : graph[selectedPrey.tetrahedron])
+            collapseQueue.volumes[connecting] = tetrahedronVolume(vertices, tetrahedrons[connecting]);
+    const auto markChanged = [&](TetIndex tetrahedron) {
+        if (collapseQueue.dirty[tetrahedron] || !lodGenerateInfo.outer[tetrahedron] || !present[tetrahedron]) return;
+        collapseQueue.dirty[tetrahedron] = 1;
+        changed.push_back(tetrahedron);
+    };
+    for (const auto& selectedPrey : selected)
+    {
+        for (const auto& [connecting, type] : graph[selectedPrey.tetrahedron])
+        {
+            markChanged(connecting);
+            for (const auto& [secondDegreeNeighbor, t] : graph[connecting])
+                markChanged(secondDegreeNeighbor);
+        }
+    }
+    std::vector<float> costs(changed.size());
+    parallelFor(changed.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            costs[i] = collapseVolumeError(graph, present, changed[i], vertices, tetrahedrons, collapseQueue.volumes);
+    });
+    for (size_t i = 0; i < changed.size(); i++)
+    {
+        const auto tetrahedron = changed[i];
+        collapseQueue.dirty[tetrahedron] = 0;
+        collapseQueue.queue.push({ costs[i], tetrahedron, ++collapseQueue.versions[tetrahedron] });
+    }
+}
+
+// Luby's independent set among the candidates: a candidate wins a round if no live candidate up to two connections
+// away has a higher rank(k), k being its position in candidates. Flip tests and rounds run in parallel, the winners
+// are taken in candidate order until the level is full. state is 0 for flipping, 1 for left over and 2 for taken candidates
+template<typename F>
+inline void selectIndependentSet(const LODGenerateInfo& lodGenerateInfo, const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons,
+    std::span<const TetIndex> candidates, F&& rank, std::vector<char>& state) {
+    auto& graph = lodGenerateInfo.graph;
+    auto& workspace = lodGenerateInfo.workspace;
+    auto& selected = workspace.selected;
+    auto& selectedPoints = workspace.selectedPoints;
+    auto& best = workspace.best;
+    if (best.size() != graph.size()) best.assign(graph.size(), 0);
+    const auto spreadRank = [&](TetIndex tetrahedron, uint32_t value) {
+        std::atomic_ref<uint32_t> target(best[tetrahedron]);
+        auto current = target.load(std::memory_order_relaxed);
+        while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    };
+
+    std::vector<uint64_t> pointOffsets(1, 0);
+    for (const auto candidate : candidates)
+        pointOffsets.push_back(pointOffsets.back() + graph[candidate].size());
+    std::vector<ConnectingPoint> points(pointOffsets.back());
+    std::vector<glm::vec4> midPoints(candidates.size());
+    std::vector<char> wins(candidates.size());
+    state.assign(candidates.size(), 0);
+    parallelFor(candidates.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            midPoints[k] = barycentre(vertices, tetrahedrons[candidates[k]]);
+            const std::span connectingPoint(points.data() + pointOffsets[k], points.data() + pointOffsets[k + 1]);
+            state[k] = !collapseFlips(lodGenerateInfo, candidates[k], midPoints[k], vertices, tetrahedrons, connectingPoint);
+        }
+    });
+    std::vector<size_t> live;
+    for (size_t k = 0; k < candidates.size(); k++)
+        if (state[k]) live.push_back(k);
+
+    while (!live.empty() && selected.size() < COLAPSING_PER_LEVEL)
+    {
+        parallelFor(live.size(), [&](size_t, size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                const auto candidate = candidates[live[k]];
+                const auto value = rank(live[k]);
+                spreadRank(candidate, value);
+                for (const auto& [connecting, type] : graph[candidate])
+                    spreadRank(connecting, value);
+            }
+        });
+        parallelFor(live.size(), [&](size_t, size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                const auto candidate = candidates[live[k]];
+                const auto value = rank(live[k]);
+                bool won = best[candidate] == value;
+                for (const auto& [connecting, type] : graph[candidate])
+                    won = won && best[connecting] == value;
+                wins[live[k]] = won;
+            }
+        });
+        parallelFor(live.size(), [&](size_t, size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                const auto candidate = candidates[live[k]];
+                std::atomic_ref<uint32_t>(best[candidate]).store(0, std::memory_order_relaxed);
+                for (const auto& [connecting, type] : graph[candidate])
+                    std::atomic_ref<uint32_t>(best[connecting]).store(0, std::memory_order_relaxed);
+            }
+        });
+
+        for (const auto k : live)
+        {
+            if (selected.size() == COLAPSING_PER_LEVEL) break;
+            if (!wins[k]) continue;
+            state[k] = 2;
+            selected.push_back({ candidates[k], midPoints[k], selectedPoints.size() });
+            selectedPoints.insert(selectedPoints.end(), points.begin() + pointOffsets[k], points.begin() + pointOffsets[k + 1]);
+            blockNeighbourhood(graph, workspace, candidates[k]);
+        }
+        std::erase_if(live, [&](size_t k) { return !isAvailable(lodGenerateInfo, candidates[k]); });
+    }
+}
+
+// Windowed over the tetrahedrons in index order, every candidate has a fixed pseudo random rank
+inline void selectIndependentPreys(const LODGenerateInfo& lodGenerateInfo, const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons) {
+    auto& graph = lodGenerateInfo.graph;
+    const auto& selected = lodGenerateInfo.workspace.selected;
+    const uint32_t seed = (uint32_t)lodGenerateInfo.level * 0x85EBCA6Bu;
+    std::vector<TetIndex> candidates;
+    std::vector<char> state;
+    // Bijective, so two candidates never share a rank
+    const auto rank = [&](size_t k) { return (candidates[k] ^ seed) * 0x9E3779B1u; };
+    size_t window = COLAPSING_PER_LEVEL * 16;
+    for (size_t start = 0; start < graph.size() && selected.size() < COLAPSING_PER_LEVEL; start += window, window *= 2)
+    {
+        const size_t end = std::min(graph.size(), start + window);
+        candidates.clear();
+        for (size_t i = start; i < end; i++)
+            if (lodGenerateInfo.outer[i] && isAvailable(lodGenerateInfo, (TetIndex)i)) candidates.push_back((TetIndex)i);
+        selectIndependentSet(lodGenerateInfo, vertices, tetrahedrons, candidates, rank, state);
+    }
+}
+
+// Batches of the cheapest candidates of the collapse queue, a cheaper candidate ranks higher. As with
+// selectCheapestPreys blocked and left over candidates go back, flipping ones wait for a cost update
+inline void selectCheapestIndependentPreys(const LODGenerateInfo& lodGenerateInfo, const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons) {
+    auto& collapseQueue = preparedCollapseQueue(lodGenerateInfo, vertices, tetrahedrons);
+    const auto& selected = lodGenerateInfo.workspace.selected;
+    std::vector<CollapseCandidate> batch;
+    std::vector<CollapseCandidate> blocked;
+    std::vector<TetIndex> candidates;
+    std::vector<char> state;
+    const auto rank = [&](size_t k) { return (uint32_t)(candidates.size() - k); };
+    size_t batchSize = COLAPSING_PER_LEVEL * 4;
+    while (!collapseQueue.queue.empty() && selected.size() < COLAPSING_PER_LEVEL)
+    {
+        batch.clear();
+        candidates.clear();
+        while (!collapseQueue.queue.empty() && batch.size() < batchSize)
+        {
+            const auto candidate = collapseQueue.queue.top();
+            collapseQueue.queue.pop();
+            if (candidate.version != collapseQueue.versions[candidate.tetrahedron] || !lodGenerateInfo.previous[candidate.tetrahedron]) continue;
+            if (!isAvailable(lodGenerateInfo, candidate.tetrahedron)) {
+                blocked.push_back(candidate);
+                continue;
+            }
+            batch.push_back(candidate);
+            candidates.push_back(candidate.tetrahedron);
+        }
+        selectIndependentSet(lodGenerateInfo, vertices, tetrahedrons, candidates, rank, state);
+        for (size_t k = 0; k < batch.size(); k++)
+            if (state[k] == 1) blocked.push_back(batch[k]);
+        batchSize *= 2;
+    }
+    for (const auto& candidate : blocked)
+        collapseQueue.queue.push(candidate);
+}
+
+inline LODLevel loadLODLevel(const LODGenerateInfo& lodGenerateInfo, std::vector<glm::vec4>& vertices,
+    std::vector<Tetrahedron>& tetrahedrons) {
+
+    LODLevel level;
+    level.usageAfter = lodGenerateInfo.previous;
+    level.lodLevelChanges.reserve(COLAPSING_PER_LEVEL * 4);
+
+    auto& workspace = lodGenerateInfo.workspace;
+    if (workspace.blocked.size() != lodGenerateInfo.graph.size()) {
+        workspace.blocked.assign(lodGenerateInfo.graph.size(), 0);
+        workspace.shared.assign(lodGenerateInfo.graph.size(), 0);
+        workspace.epoch = 0;
+    }
+    workspace.epoch++;
+    auto& selected = workspace.selected;
+    auto& selectedPoints = workspace.selectedPoints;
+    selected.clear();
+    selectedPoints.clear();
+    // The heuristic orders the candidates, the selection decides how they are taken
+    const bool cheapest = lodGenerateInfo.heuristic == Heuristic::VolumeError;
+    if (lodGenerateInfo.selection == PreySelection::IndependentSet) {
+        if (cheapest) selectCheapestIndependentPreys(lodGenerateInfo, vertices, tetrahedrons);
+        else selectIndependentPreys(lodGenerateInfo, vertices, tetrahedrons);
+    }
+    else if (cheapest) {
+        selectCheapestPreys(lodGenerateInfo, vertices, tetrahedrons);
+    }
+    else {
+        for (size_t i = 0; i < lodGenerateInfo.graph.size(); i++)
+        {
+            if (selected.size() == COLAPSING_PER_LEVEL)
+                break;
+            if (!lodGenerateInfo.outer[i] || !isAvailable(lodGenerateInfo, (TetIndex)i))
+                continue;
+            const auto preyIndex = (TetIndex)i;
+            const auto midPoint = barycentre(vertices, tetrahedrons[preyIndex]);
+            const auto pointOffset = selectedPoints.size();
+            selectedPoints.resize(pointOffset + lodGenerateInfo.graph[preyIndex].size());
+            const std::span connectingPoint(selectedPoints.data() + pointOffset, selectedPoints.data() + selectedPoints.size());
+            if (collapseFlips(lodGenerateInfo, preyIndex, midPoint, vertices, tetrahedrons, connectingPoint)) {
+                selectedPoints.resize(pointOffset);
+                continue;
+            }
+            selected.push_back({ preyIndex, midPoint, pointOffset });
+            blockNeighbourhood(lodGenerateInfo.graph, workspace, preyIndex);
+        }
+    }
+
+    for (const auto& [preyIndex, midPoint, pointOffset] : selected)
+    {
+        const auto& prey = tetrahedrons[preyIndex];
+        {
+            auto& lodInfo = level.lodTetrahedrons.emplace_back();
+            lodInfo.tetrahedron = prey;
+            lodInfo.next = midPoint;
+            for (size_t i = 0; i < 4; i++)
+            {
+                const auto currentPoint = vertices[prey.indices[i]];
+                lodInfo.previous[i] = currentPoint;
+            }
+        }
+        level.usageAfter[preyIndex] = 0;
+        size_t indexOfNeighbour = 0;
+        const auto newIndex = prey.indices[0];
+        for (const auto& [connecting, type] : lodGenerateInfo.graph[preyIndex])
+        {
+            indexOfNeighbour++;
+            if (type == EdgeType::Point) {
+                if (!lodGenerateInfo.previous[connecting]) continue;
+                const auto [point, index] = selectedPoints[pointOffset + indexOfNeighbour - 1];
+                if(index == newIndex) continue;
+                level.lodLevelChanges.emplace_back(index, point, newIndex, connecting);
+                continue;
+            }
+            // Only Edge and Face connections are actually collapsed and lose a dimension
+            level.usageAfter[connecting] = 0;
+        }
+    }
+
+    for (const auto& vertexUpdate : level.lodTetrahedrons)
+    {
+        vertices[vertexUpdate.tetrahedron.indices[0]] = vertexUpdate.next;
+    }
+    for (const auto& indexUpdate : level.lodLevelChanges)
+    {
+        tetrahedrons[indexUpdate.tetrahedronID].indices[indexUpdate.indexInTet] = indexUpdate.newIndex;
+        workspace.incidence.move(indexUpdate.tetrahedronID, indexUpdate.oldIndex, indexUpdate.newIndex);
+    }
+
+    // Neighbours of a prey now share its collapsed vertex, so their connections among each other get promoted.
+    // Shared vertices are counted through the incidence and matched against the row of the neighbour in one pass
+    static constexpr uint8_t PENDING = 0x80;
+    auto& shared = workspace.shared;
+    auto& touched = workspace.touched;
+    for (const auto& selectedPrey : selected)
+    {
+        const auto& neighbours = lodGenerateInfo.graph[selectedPrey.tetrahedron];
+        for (const auto& [neighbor, type] : neighbours) {
+            if (!level.usageAfter[neighbor]) continue;
+            const auto& indices = tetrahedrons[neighbor].indices;
+            for (size_t i = 0; i < 4; i++) {
+                if (std::find(indices, indices + i, indices[i]) != indices + i) continue;
+                for (const auto other : workspace.incidence[indices[i]])
+                    if (shared[other]++ == 0) touched.push_back(other);
+            }
+            for (const auto& [other, otherType] : neighbours) {
+                if (!level.usageAfter[other] || neighbor == other || shared[other] == 0) continue;
+                if (shared[other] > 3) {
+                    level.usageAfter[other] = 0;
+                }
+                shared[other] |= PENDING;
+            }
+            for (auto& connection : lodGenerateInfo.graph[neighbor]) {
+                auto& amount = shared[connection.tetrahedron];
+                if (!(amount & PENDING)) continue;
+                amount &= ~PENDING;
+                connection.type = (EdgeType)amount;
+            }
+            for (const auto& [other, otherType] : neighbours) {
+                auto& amount = shared[other];
+                if (!(amount & PENDING)) continue;
+                amount &= ~PENDING;
+                lodGenerateInfo.graph.append(neighbor, other, (EdgeType)amount);
+            }
+            for (const auto other : touched)
+                shared[other] = 0;
+            touched.clear();
+        }
+    }
+    if (lodGenerateInfo.heuristic == Heuristic::VolumeError) {
+        updateCollapseCosts(lodGenerateInfo, level.usageAfter, selected, vertices, tetrahedrons);
+    }
+
+    if (level.lodTetrahedrons.empty()) {
+        std::cout << "Warning: No preys found for model " << lodGenerateInfo.name << " at level " << stringLODLevel(lodGenerateInfo.level) << std::endl;
+    }
+    else if (level.lodTetrahedrons.size() < COLAPSING_PER_LEVEL) {
+        std::cout << "Warning: Not enough preys found for model " << lodGenerateInfo.name << " at level " << stringLODLevel(lodGenerateInfo.level) << std::endl;
+    }
+    return level;
+}
+
+struct MeshData {
+    std::vector<glm::vec4> vertices;
+    std::vector<Tetrahedron> tetrahedrons;
+    AABB aabb;
+};
+
+inline bool isWhitespace(char value) {
+    return value == ' ' || value == '\t' || value == '\r' || value == '\n';
+}
+
+inline const char* skipWhitespace(const char* current, const char* end) {
+    while (current < end && isWhitespace(*current))
+        current++;
+    return current;
+}
+
+inline const char* nextLine(const char* current, const char* end) {
+    current = std::find(current, end, '\n');
+    return current == end ? end : current + 1;
+}
+
+inline std::string_view nextToken(const char*& current, const char* end) {
+    current = skipWhitespace(current, end);
+    const char* begin = current;
+    while (current < end && !isWhitespace(*current))
+        current++;
+    return std::string_view(begin, current - begin);
+}
+
+template<typename T>
+inline const char* parseNumber(const char* current, const char* end, T& value) {
+    current = skipWhitespace(current, end);
+    // from_chars does not accept a leading plus sign, streams do
+    if (current < end && *current == '+') current++;
+    const auto [next, error] = std::from_chars(current, end, value);
+    if (error != std::errc()) throw std::runtime_error("Malformed number in mesh file!");
+    return next;
+}
+
+// Amount of lines with any content, blank lines are not counted
+inline size_t countRecords(const char* current, const char* end) {
+    size_t amount = 0;
+    bool content = false;
+    for (; current < end; current++)
+    {
+        if (*current == '\n') {
+            amount += content;
+            content = false;
+        }
+        else if (!isWhitespace(*current)) {
+            content = true;
+        }
+    }
+    return amount + content;
+}
+
+// Splits [begin, end) into one chunk per core, every boundary is moved behind the next line break
+inline std::vector<const char*> lineAlignedChunks(const char* begin, const char* end) {
+    const size_t size = end - begin;
+    const size_t chunkAmount = std::max<size_t>(1u, std::min(amountOfWorkers(), size / 4096));
+    std::vector<const char*> boundaries(chunkAmount + 1, end);
+    boundaries[0] = begin;
+    for (size_t i = 1; i < chunkAmount; i++)
+    {
+        const char* split = std::max(begin + size * i / chunkAmount, boundaries[i - 1]);
+        boundaries[i] = nextLine(split, end);
+    }
+    return boundaries;
+}
+
+inline uint32_t byteSwap(uint32_t value) {
+    return (value >> 24) | ((value >> 8) & 0xFF00u) | ((value << 8) & 0xFF0000u) | (value << 24);
+}
+
+inline void byteSwap32(uint32_t* values, size_t amount) {
+    size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX__)
+    const __m128i reverse = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 4 <= amount; i += 4)
+    {
+        const __m128i value = _mm_loadu_si128((const __m128i*)(values + i));
+        _mm_storeu_si128((__m128i*)(values + i), _mm_shuffle_epi8(value, reverse));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= amount; i += 4)
+        vst1q_u8((uint8_t*)(values + i), vrev32q_u8(vld1q_u8((const uint8_t*)(values + i))));
+#endif
+    // Remainder, without SIMD headers this form is auto vectorized by the compilers we use
+    for (; i < amount; i++)
+        values[i] = byteSwap(values[i]);
+}
+
+inline void byteSwap64(uint64_t* values, size_t amount) {
+    size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX__)
+    const __m128i reverse = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (; i + 2 <= amount; i += 2)
+    {
+        const __m128i value = _mm_loadu_si128((const __m128i*)(values + i));
+        _mm_storeu_si128((__m128i*)(values + i), _mm_shuffle_epi8(value, reverse));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 2 <= amount; i += 2)
+        vst1q_u8((uint8_t*)(values + i), vrev64q_u8(vld1q_u8((const uint8_t*)(values + i))));
+#endif
+    for (; i < amount; i++)
+    {
+        const auto value = values[i];
+        values[i] = ((uint64_t)byteSwap((uint32_t)value) << 32) | byteSwap((uint32_t)(value >> 32));
+    }
+}
+
+// Copies a big endian payload out of the mapped file and converts it to the host byte order
+template<typename T>
+inline const char* readBigEndian(const char* current, const char* end, std::vector<T>& values) {
+    static_assert(sizeof(T) == sizeof(uint32_t) || sizeof(T) == sizeof(uint64_t));
+    const size_t byteSize = values.size() * sizeof(T);
+    if ((size_t)(end - current) < byteSize) throw std::runtime_error("Unexpected end of mesh file!");
+    std::memcpy(values.data(), current, byteSize);
+    if constexpr (std::endian::native == std::endian::little) {
+        parallelFor(values.size(), [&](size_t, size_t first, size_t last) {
+            if constexpr (sizeof(T) == sizeof(uint32_t)) byteSwap32((uint32_t*)values.data() + first, last - first);
+            else byteSwap64((uint64_t*)values.data() + first, last - first);
+            });
+    }
+    return current + byteSize;
+}
+
+// Indices are only known to be valid once the whole mesh was read
+inline void checkVertexIndices(const MeshData& mesh, const std::string& fileType) {
+    std::atomic<bool> outOfRange = false;
+    parallelFor(mesh.tetrahedrons.size(), [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            for (const auto index : mesh.tetrahedrons[i].indices)
+                if (index >= mesh.vertices.size()) outOfRange.store(true, std::memory_order_relaxed);
+        });
+    if (outOfRange) throw std::runtime_error("Vertex index out of range in " + fileType + " file!");
+}
+
+// Parses a line aligned part of the v/t format, indices are global so chunks can simply be appended.
+// Stops after maxElements elements and returns where it stopped
+inline const char* parseMeshChunk(const char* current, const char* end, MeshData& chunk, size_t maxElements = std::numeric_limits<size_t>::max()) {
+    while (chunk.vertices.size() + chunk.tetrahedrons.size() < maxElements && (current = skipWhitespace(current, end)) < end)
+    {
+        const char type = *current++;
+        if (type == 'v') {
+            glm::vec4 vertex;
+            current = parseNumber(current, end, vertex.x);
+            current = parseNumber(current, end, vertex.y);
+            current = parseNumber(current, end, vertex.z);
+            vertex.w = 1.0f;
+            chunk.vertices.push_back(vertex);
+            chunk.aabb.max = glm::max(chunk.aabb.max, glm::vec3(vertex));
+            chunk.aabb.min = glm::min(chunk.aabb.min, glm::vec3(vertex));
+        }
+        else if (type == 't') {
+            Tetrahedron tetrahedron;
+            for (auto& index : tetrahedron.indices)
+                current = parseNumber(current, end, index);
+            chunk.tetrahedrons.push_back(tetrahedron);
+        }
+        else {
+            throw std::runtime_error("Unknown element in mesh file!");
+        }
+    }
+    return current;
+}
+
+// The project's own format: lines "v x y z" and "t i0 i1 i2 i3" in any order
+inline MeshData parseVertexTetrahedronMesh(const MappedFile& file) {
+    const auto boundaries = lineAlignedChunks(file.data, file.data + file.size);
+    const size_t chunkAmount = boundaries.size() - 1;
+
+    std::vector<MeshData> chunks(chunkAmount);
+    parallelFor(chunkAmount, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            parseMeshChunk(boundaries[i], boundaries[i + 1], chunks[i]);
+        });
+
+    MeshData mesh;
+    size_t vertexAmount = 0;
+    size_t tetrahedronAmount = 0;
+    for (const auto& chunk : chunks)
+    {
+        vertexAmount += chunk.vertices.size();
+        tetrahedronAmount += chunk.tetrahedrons.size();
+    }
+    mesh.vertices.reserve(vertexAmount);
+    mesh.tetrahedrons.reserve(tetrahedronAmount);
+    for (const auto& chunk : chunks)
+    {
+        mesh.vertices.insert(mesh.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        mesh.tetrahedrons.insert(mesh.tetrahedrons.end(), chunk.tetrahedrons.begin(), chunk.tetrahedrons.end());
+        mesh.aabb = extendAABB(mesh.aabb, chunk.aabb);
+    }
+    checkVertexIndices(mesh, "mesh");
+    return mesh;
+}
+
+// TetGen style: "<n> vertices", "<m> tets", n lines "x y z", m lines "4 i0 i1 i2 i3"
+inline MeshData parseTetGenMesh(const MappedFile& file) {
+    const char* end = file.data + file.size;
+    const char* current = file.data;
+    size_t vertexAmount = 0;
+    size_t tetrahedronAmount = 0;
+    current = parseNumber(current, end, vertexAmount);
+    if (nextToken(current, end) != "vertices") throw std::runtime_error("Missing vertices header in tet file!");
+    current = parseNumber(current, end, tetrahedronAmount);
+    if (nextToken(current, end) != "tets") throw std::runtime_error("Missing tets header in tet file!");
+    current = nextLine(current, end);
+
+    MeshData mesh;
+    mesh.vertices.resize(vertexAmount);
+    mesh.tetrahedrons.resize(tetrahedronAmount);
+
+    // First pass counts the records of every chunk, so the second one knows where its elements go
+    const auto boundaries = lineAlignedChunks(current, end);
+    const size_t chunkAmount = boundaries.size() - 1;
+    std::vector<size_t> firstRecord(chunkAmount + 1, 0);
+    parallelFor(chunkAmount, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            firstRecord[i + 1] = countRecords(boundaries[i], boundaries[i + 1]);
+        });
+    std::partial_sum(firstRecord.begin(), firstRecord.end(), firstRecord.begin());
+    if (firstRecord.back() != vertexAmount + tetrahedronAmount)
+        throw std::runtime_error("Element count does not match the tet file header!");
+
+    std::vector<AABB> chunkAABB(chunkAmount);
+    parallelFor(chunkAmount, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            const char* chunk = boundaries[i];
+            auto& aabb = chunkAABB[i];
+            for (size_t record = firstRecord[i]; record < firstRecord[i + 1]; record++)
+            {
+                if (record < vertexAmount) {
+                    auto& vertex = mesh.vertices[record];
+                    chunk = parseNumber(chunk, boundaries[i + 1], vertex.x);
+                    chunk = parseNumber(chunk, boundaries[i + 1], vertex.y);
+                    chunk = parseNumber(chunk, boundaries[i + 1], vertex.z);
+                    vertex.w = 1.0f;
+                    aabb.max = glm::max(aabb.max, glm::vec3(vertex));
+                    aabb.min = glm::min(aabb.min, glm::vec3(vertex));
+                    continue;
+                }
+                uint32_t cornerAmount = 0;
+                chunk = parseNumber(chunk, boundaries[i + 1], cornerAmount);
+                if (cornerAmount != 4) throw std::runtime_error("Only tetrahedral cells are supported!");
+                for (auto& index : mesh.tetrahedrons[record - vertexAmount].indices)
+                    chunk = parseNumber(chunk, boundaries[i + 1], index);
+            }
+        }
+        });
+    for (const auto& aabb : chunkAABB)
+        mesh.aabb = extendAABB(mesh.aabb, aabb);
+    checkVertexIndices(mesh, "tet");
+    return mesh;
+}
+
+constexpr uint32_t VTK_TETRA = 10;
+
+// Legacy VTK UNSTRUCTURED_GRID, BINARY payloads are big endian, only VTK_TETRA cells are kept
+inline MeshData parseLegacyVTKMesh(const MappedFile& file) {
+    const char* end = file.data + file.size;
+    const char* current = nextLine(file.data, end); // # vtk DataFile Version x.x
+    current = nextLine(current, end); // Title
+    const auto encoding = nextToken(current, end);
+    if (encoding != "BINARY" && encoding != "ASCII") throw std::runtime_error("Unknown encoding in vtk file!");
+    const bool binary = encoding == "BINARY";
+    if (nextToken(current, end) != "DATASET" || nextToken(current, end) != "UNSTRUCTURED_GRID")
+        throw std::runtime_error("Only UNSTRUCTURED_GRID datasets are supported!");
+
+    MeshData mesh;
+    std::vector<uint32_t> cells;
+    std::vector<uint32_t> cellTypes;
+    while (true) {
+        const auto keyword = nextToken(current, end);
+        if (keyword == "POINTS") {
+            size_t amount = 0;
+            current = parseNumber(current, end, amount);
+            const auto type = nextToken(current, end);
+            if (type != "float" && type != "double") throw std::runtime_error("Unsupported point type in vtk file!");
+            mesh.vertices.resize(amount);
+            if (!binary) {
+                for (auto& vertex : mesh.vertices)
+                {
+                    current = parseNumber(current, end, vertex.x);
+                    current = parseNumber(current, end, vertex.y);
+                    current = parseNumber(current, end, vertex.z);
+                    vertex.w = 1.0f;
+                }
+                continue;
+            }
+            current = nextLine(current, end);
+            std::vector<uint32_t> floats;
+            std::vector<uint64_t> doubles;
+            if (type == "float") {
+                floats.resize(amount * 3);
+                current = readBigEndian(current, end, floats);
+            }
+            else {
+                doubles.resize(amount * 3);
+                current = readBigEndian(current, end, doubles);
+            }
+            parallelFor(amount, [&](size_t, size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                {
+                    for (size_t j = 0; j < 3; j++)
+                        mesh.vertices[i][j] = floats.empty() ? (float)std::bit_cast<double>(doubles[i * 3 + j])
+                                                             : std::bit_cast<float>(floats[i * 3 + j]);
+                    mesh.vertices[i].w = 1.0f;
+                }
+                });
+        }
+        else if (keyword == "CELLS") {
+            size_t amount = 0;
+            size_t size = 0;
+            current = parseNumber(current, end, amount);
+            current = parseNumber(current, end, size);
+            cells.resize(size);
+            if (binary) {
+                current = readBigEndian(nextLine(current, end), end, cells);
+            }
+            else {
+                for (auto& value : cells)
+                    current = parseNumber(current, end, value);
+            }
+        }
+        else if (keyword == "CELL_TYPES") {
+            size_t amount = 0;
+            current = parseNumber(current, end, amount);
+            cellTypes.resize(amount);
+            if (binary) {
+                current = readBigEndian(nextLine(current, end), end, cellTypes);
+            }
+            else {
+                for (auto& value : cellTypes)
+                    current = parseNumber(current, end, value);
+            }
+        }
+        else {
+            // End of file or attribute data (POINT_DATA, CELL_DATA, ...) which is not needed
+            break;
+        }
+    }
+
+    const size_t tetrahedronAmount = std::ranges::count(cellTypes, VTK_TETRA);
+    mesh.tetrahedrons.resize(tetrahedronAmount);
+    if (tetrahedronAmount == cellTypes.size() && cells.size() == tetrahedronAmount * 5) {
+        // Pure tetrahedral grid, every cell is "4 i0 i1 i2 i3"
+        parallelFor(tetrahedronAmount, [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                if (cells[i * 5] != 4) throw std::runtime_error("Malformed tetrahedron in vtk file!");
+                std::copy_n(cells.begin() + i * 5 + 1, 4, mesh.tetrahedrons[i].indices);
+            }
+            });
+    }
+    else {
+        size_t offset = 0;
+        size_t tetrahedron = 0;
+        for (const auto type : cellTypes)
+        {
+            if (offset >= cells.size()) throw std::runtime_error("Malformed cells in vtk file!");
+            const auto cornerAmount = cells[offset];
+            if (offset + cornerAmount >= cells.size()) throw std::runtime_error("Malformed cells in vtk file!");
+            if (type == VTK_TETRA) {
+                if (cornerAmount != 4) throw std::runtime_error("Malformed tetrahedron in vtk file!");
+                std::copy_n(cells.begin() + offset + 1, 4, mesh.tetrahedrons[tetrahedron++].indices);
+            }
+            offset += cornerAmount + 1;
+        }
+    }
+    checkVertexIndices(mesh, "vtk");
+
+    std::vector<AABB> chunkAABB(amountOfWorkers());
+    parallelFor(mesh.vertices.size(), [&](size_t worker, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            chunkAABB[worker].max = glm::max(chunkAABB[worker].max, glm::vec3(mesh.vertices[i]));
+            chunkAABB[worker].min = glm::min(chunkAABB[worker].min, glm::vec3(mesh.vertices[i]));
+        }
+        });
+    for (const auto& aabb : chunkAABB)
+        mesh.aabb = extendAABB(mesh.aabb, aabb);
+    return mesh;
+}
+
+enum class MeshFormat {
+    VertexTetrahedron, TetGen, LegacyVTK
+};
+
+inline MeshFormat meshFormat(const std::string& vtkFile, const MappedFile& file) {
+    if (std::filesystem::path(vtkFile).extension() == ".tet")
+        return MeshFormat::TetGen;
+    if (std::string_view(file.data, std::min<size_t>(file.size, 5)) == "# vtk")
+        return MeshFormat::LegacyVTK;
+    return MeshFormat::VertexTetrahedron;
+}
+
+inline MeshData parseMesh(const std::string& vtkFile) {
+    const MappedFile file(vtkFile);
+    switch (meshFormat(vtkFile, file))
+    {
+    case MeshFormat::TetGen: return parseTetGenMesh(file);
+    case MeshFormat::LegacyVTK: return parseLegacyVTKMesh(file);
+    default: return parseVertexTetrahedronMesh(file);
+    }
+}
+
+// Vertices closer than this in every coordinate are the same vertex
+constexpr float WELD_EPSILON = 1e-6f;
+
+inline uint32_t weldBucket(const std::array<int64_t, 3>& cell, uint32_t bits) {
+    const uint64_t hash = (uint64_t)cell[0] * 73856093u ^ (uint64_t)cell[1] * 19349663u ^ (uint64_t)cell[2] * 83492791u;
+    return (uint32_t)((hash * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+// Merges duplicated vertices and remaps the tetrahedrons, tetrahedrons collapsed by the merge are removed.
+// Vertices are bucketed on a uniform grid with cell size 2 * epsilon, so only the 8 cells towards the closer
+// neighbours are searched and every vertex is replaced by the lowest index within epsilon.
+// Returns the amount of merged vertices
+inline size_t weldVertices(MeshData& mesh, float epsilon = WELD_EPSILON) {
+    auto& vertices = mesh.vertices;
+    const size_t amount = vertices.size();
+    if (amount < 2) return 0;
+    const double inverseCellSize = 0.5 / epsilon;
+    const auto cellOf = [&](const glm::vec4& vertex) {
+        return std::array<int64_t, 3>{ (int64_t)std::floor(vertex.x * inverseCellSize),
+            (int64_t)std::floor(vertex.y * inverseCellSize), (int64_t)std::floor(vertex.z * inverseCellSize) };
+    };
+
+    // Counting sort into a hash table with at least one bucket per vertex
+    const uint32_t bits = std::max<uint32_t>(1u, std::bit_width(amount - 1));
+    std::vector<uint32_t> bucketOf(amount);
+    std::vector<std::atomic<uint32_t>> bucketStart((size_t(1) << bits) + 1);
+    parallelFor(amount, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            bucketOf[i] = weldBucket(cellOf(vertices[i]), bits);
+            bucketStart[bucketOf[i] + 1].fetch_add(1, std::memory_order_relaxed);
+        }
+        });
+    for (size_t i = 1; i < bucketStart.size(); i++)
+        bucketStart[i].store(bucketStart[i] + bucketStart[i - 1], std::memory_order_relaxed);
+    std::vector<uint32_t> sorted(amount);
+    {
+        std::vector<std::atomic<uint32_t>> cursor(bucketStart.size() - 1);
+        parallelFor(amount, [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                sorted[bucketStart[bucketOf[i]] + cursor[bucketOf[i]].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)i;
+            });
+    }
+
+    std::vector<VertIndex> representative(amount);
+    parallelFor(amount, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            const auto cell = cellOf(vertices[i]);
+            // Neighbour cell in the direction of the half the vertex lies in
+            std::array<int64_t, 3> side;
+            for (size_t axis = 0; axis < 3; axis++)
+                side[axis] = vertices[i][axis] * inverseCellSize - cell[axis] < 0.5 ? -1 : 1;
+            VertIndex lowest = (VertIndex)i;
+            for (int64_t x = 0; x < 2; x++)
+                for (int64_t y = 0; y < 2; y++)
+                    for (int64_t z = 0; z < 2; z++)
+                    {
+                        const auto bucket = weldBucket({ cell[0] + x * side[0], cell[1] + y * side[1], cell[2] + z * side[2] }, bits);
+                        for (uint32_t j = bucketStart[bucket]; j < bucketStart[bucket + 1]; j++)
+                        {
+                            const auto other = sorted[j];
+                            if (other >= lowest) continue;
+                            const auto& vertex = vertices[i];
+                            const auto& candidate = vertices[other];
+                            if (std::abs(vertex.x - candidate.x) <= epsilon && std::abs(vertex.y - candidate.y) <= epsilon &&
+                                std::abs(vertex.z - candidate.z) <= epsilon)
+                                lowest = other;
+                        }
+                    }
+            representative[i] = lowest;
+        }
+        });
+
+    // Representatives always have a lower index, so one pass in order resolves chains
+    std::vector<VertIndex> remap(amount);
+    size_t kept = 0;
+    for (size_t i = 0; i < amount; i++)
+    {
+        representative[i] = representative[representative[i]];
+        if (representative[i] == i) {
+            remap[i] = (VertIndex)kept;
+            vertices[kept++] = vertices[i];
+        }
+        else {
+            remap[i] = remap[representative[i]];
+        }
+    }
+    if (kept == amount) return 0;
+    vertices.resize(kept);
+
+    parallelFor(mesh.tetrahedrons.size(), [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            for (auto& index : mesh.tetrahedrons[i].indices)
+                index = remap[index];
+        });
+    const auto collapsed = std::erase_if(mesh.tetrahedrons, [](const Tetrahedron& tetrahedron) {
+        const auto& indices = tetrahedron.indices;
+        return indices[0] == indices[1] || indices[0] == indices[2] || indices[0] == indices[3] ||
+            indices[1] == indices[2] || indices[1] == indices[3] || indices[2] == indices[3];
+        });
+    if (collapsed != 0)
+        std::cout << "Warning: Removed " << collapsed << " tetrahedrons collapsed by welding" << std::endl;
+    return amount - kept;
+}
+
+inline uint32_t readBigEndian32(const char* current) {
+    uint32_t value;
+    std::memcpy(&value, current, sizeof(value));
+    return std::endian::native == std::endian::little ? byteSwap(value) : value;
+}
+
+// Hands out a mesh in pieces of bounded size for the streaming loader. The element amounts are known
+// before the first piece, either from the header or from a counting pass over the mapped file
+struct MeshChunkReader {
+    MappedFile file;
+    MeshFormat format;
+    uint64_t vertexAmount = 0;
+    uint64_t tetrahedronAmount = 0;
+    uint64_t verticesRead = 0;
+    uint64_t tetrahedronsRead = 0;
+    const char* current = nullptr;
+    const char* end = nullptr;
+    // BINARY legacy VTK payloads
+    bool doublePoints = false;
+    const char* points = nullptr;
+    const char* cells = nullptr;
+    const char* cellsEnd = nullptr;
+    const char* cellTypes = nullptr;
+    uint64_t cellAmount = 0;
+    uint64_t cellsRead = 0;
+    std::vector<uint32_t> floats;
+    std::vector<uint64_t> doubles;
+
+    MeshChunkReader(const std::string& vtkFile) : file(vtkFile) {
+        format = meshFormat(vtkFile, file);
+        current = file.data;
+        end = file.data + file.size;
+        switch (format)
+        {
+        case MeshFormat::TetGen:
+            current = parseNumber(current, end, vertexAmount);
+            if (nextToken(current, end) != "vertices") throw std::runtime_error("Missing vertices header in tet file!");
+            current = parseNumber(current, end, tetrahedronAmount);
+            if (nextToken(current, end) != "tets") throw std::runtime_error("Missing tets header in tet file!");
+            current = nextLine(current, end);
+            break;
+        case MeshFormat::LegacyVTK:
+            openLegacyVTK();
+            break;
+        default:
+            countVertexTetrahedron();
+            break;
+        }
+    }
+
+    // Replaces the content of chunk with at most maxElements vertices and tetrahedrons in file order,
+    // returns false once the whole mesh was handed out
+    bool next(MeshData& chunk, size_t maxElements) {
+        chunk.vertices.clear();
+        chunk.tetrahedrons.clear();
+        chunk.aabb = AABB();
+        switch (format)
+        {
+        case MeshFormat::TetGen: nextTetGen(chunk, maxElements); break;
+        case MeshFormat::LegacyVTK: nextLegacyVTK(chunk, maxElements); break;
+        default: current = parseMeshChunk(current, end, chunk, maxElements); break;
+        }
+        verticesRead += chunk.vertices.size();
+        tetrahedronsRead += chunk.tetrahedrons.size();
+        return !chunk.vertices.empty() || !chunk.tetrahedrons.empty();
+    }
+
+private:
+    void countVertexTetrahedron() {
+        const auto boundaries = lineAlignedChunks(current, end);
+        std::vector<std::array<uint64_t, 2>> counts(boundaries.size() - 1, { 0, 0 });
+        parallelFor(counts.size(), [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                for (const char* line = boundaries[i]; (line = skipWhitespace(line, boundaries[i + 1])) < boundaries[i + 1]; line = nextLine(line, boundaries[i + 1]))
+                {
+                    if (*line == 'v') counts[i][0]++;
+                    else if (*line == 't') counts[i][1]++;
+                    else throw std::runtime_error("Unknown element in mesh file!");
+                }
+            }
+            });
+        for (const auto& count : counts)
+        {
+            vertexAmount += count[0];
+            tetrahedronAmount += count[1];
+        }
+    }
+
+    const char* skipPayload(const char* payload, uint64_t byteSize) const {
+        if ((uint64_t)(end - payload) < byteSize) throw std::runtime_error("Unexpected end of mesh file!");
+        return payload + byteSize;
+    }
+
+    // Only remembers where the payloads are, nothing is copied
+    void openLegacyVTK() {
+        current = nextLine(current, end); // # vtk DataFile Version x.x
+        current = nextLine(current, end); // Title
+        if (nextToken(current, end) != "BINARY") throw std::runtime_error("Streaming needs a BINARY vtk file!");
+        if (nextToken(current, end) != "DATASET" || nextToken(current, end) != "UNSTRUCTURED_GRID")
+            throw std::runtime_error("Only UNSTRUCTURED_GRID datasets are supported!");
+        uint64_t cellTypeAmount = 0;
+        while (true) {
+            const auto keyword = nextToken(current, end);
+            if (keyword == "POINTS") {
+                current = parseNumber(current, end, vertexAmount);
+                const auto type = nextToken(current, end);
+                if (type != "float" && type != "double") throw std::runtime_error("Unsupported point type in vtk file!");
+                doublePoints = type == "double";
+                points = nextLine(current, end);
+                current = skipPayload(points, vertexAmount * 3 * (doublePoints ? sizeof(uint64_t) : sizeof(uint32_t)));
+            }
+            else if (keyword == "CELLS") {
+                uint64_t size = 0;
+                current = parseNumber(current, end, cellAmount);
+                current = parseNumber(current, end, size);
+                cells = nextLine(current, end);
+                current = cellsEnd = skipPayload(cells, size * sizeof(uint32_t));
+            }
+            else if (keyword == "CELL_TYPES") {
+                current = parseNumber(current, end, cellTypeAmount);
+                cellTypes = nextLine(current, end);
+                current = skipPayload(cellTypes, cellTypeAmount * sizeof(uint32_t));
+            }
+            else {
+                break;
+            }
+        }
+        if (!points || !cells || !cellTypes || cellTypeAmount != cellAmount)
+            throw std::runtime_error("Malformed cells in vtk file!");
+
+        std::vector<uint64_t> workerAmount(amountOfWorkers(), 0);
+        parallelFor(cellAmount, [&](size_t worker, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                workerAmount[worker] += readBigEndian32(cellTypes + i * sizeof(uint32_t)) == VTK_TETRA;
+            });
+        tetrahedronAmount = std::accumulate(workerAmount.begin(), workerAmount.end(), uint64_t(0));
+    }
+
+    void nextTetGen(MeshData& chunk, size_t maxElements) {
+        const size_t vertices = std::min<uint64_t>(maxElements, vertexAmount - verticesRead);
+        const size_t tetrahedrons = std::min<uint64_t>(maxElements - vertices, tetrahedronAmount - tetrahedronsRead);
+        chunk.vertices.resize(vertices);
+        chunk.tetrahedrons.resize(tetrahedrons);
+        for (auto& vertex : chunk.vertices)
+        {
+            current = parseNumber(current, end, vertex.x);
+            current = parseNumber(current, end, vertex.y);
+            current = parseNumber(current, end, vertex.z);
+            vertex.w = 1.0f;
+            chunk.aabb.max = glm::max(chunk.aabb.max, glm::vec3(vertex));
+            chunk.aabb.min = glm::min(chunk.aabb.min, glm::vec3(vertex));
+        }
+        for (auto& tetrahedron : chunk.tetrahedrons)
+        {
+            uint32_t cornerAmount = 0;
+            current = parseNumber(current, end, cornerAmount);
+            if (cornerAmount != 4) throw std::runtime_error("Only tetrahedral cells are supported!");
+            for (auto& index : tetrahedron.indices)
+                current = parseNumber(current, end, index);
+        }
+        if (vertices + tetrahedrons == 0 && skipWhitespace(current, end) != end)
+            throw std::runtime_error("Element count does not match the tet file header!");
+    }
+
+    void nextLegacyVTK(MeshData& chunk, size_t maxElements) {
+        const size_t vertices = std::min<uint64_t>(maxElements, vertexAmount - verticesRead);
+        if (vertices != 0) {
+            chunk.vertices.resize(vertices);
+            const char* payload = points + verticesRead * 3 * (doublePoints ? sizeof(uint64_t) : sizeof(uint32_t));
+            if (doublePoints) {
+                doubles.resize(vertices * 3);
+                readBigEndian(payload, end, doubles);
+            }
+            else {
+                floats.resize(vertices * 3);
+                readBigEndian(payload, end, floats);
+            }
+            for (size_t i = 0; i < vertices; i++)
+            {
+                auto& vertex = chunk.vertices[i];
+                for (size_t j = 0; j < 3; j++)
+                    vertex[j] = doublePoints ? (float)std::bit_cast<double>(doubles[i * 3 + j]) : std::bit_cast<float>(floats[i * 3 + j]);
+                vertex.w = 1.0f;
+                chunk.aabb.max = glm::max(chunk.aabb.max, glm::vec3(vertex));
+                chunk.aabb.min = glm::min(chunk.aabb.min, glm::vec3(vertex));
+            }
+        }
+        // Cells are variable sized, so they are walked one by one
+        while (chunk.vertices.size() + chunk.tetrahedrons.size() < maxElements && cellsRead < cellAmount)
+        {
+            if (cells + sizeof(uint32_t) > cellsEnd) throw std::runtime_error("Malformed cells in vtk file!");
+            const auto cornerAmount = readBigEndian32(cells);
+            if ((uint64_t)(cellsEnd - cells) < (cornerAmount + 1) * sizeof(uint32_t)) throw std::runtime_error("Malformed cells in vtk file!");
+            if (readBigEndian32(cellTypes + cellsRead * sizeof(uint32_t)) == VTK_TETRA) {
+                if (cornerAmount != 4) throw std::runtime_error("Malformed tetrahedron in vtk file!");
+                Tetrahedron tetrahedron;
+                for (size_t i = 0; i < 4; i++)
+                    tetrahedron.indices[i] = readBigEndian32(cells + (i + 1) * sizeof(uint32_t));
+                chunk.tetrahedrons.push_back(tetrahedron);
+            }
+            cells += (cornerAmount + 1) * sizeof(uint32_t);
+            cellsRead++;
+        }
+    }
+};
+
+// Sorts more records than fit into memory: full buffers are sorted and spilled as runs into
+// temporary files, merge() then streams all records in order through a k-way merge
+template<typename Record>
+struct ExternalSorter {
+    std::filesystem::path directory;
+    std::string name;
+    size_t runCapacity;
+    std::vector<Record> buffer;
+    std::vector<std::filesystem::path> runs;
+
+    ExternalSorter(const std::filesystem::path& directory, size_t memoryBudget) : directory(directory),
+        runCapacity(std::max<size_t>(1u, memoryBudget / sizeof(Record))) {
+        static std::atomic<uint64_t> sorterCount = 0;
+        name = "sort_" + std::to_string(std::random_device()()) + "_" + std::to_string(sorterCount++);
+    }
+
+    ~ExternalSorter() {
+        std::error_code error;
+        for (const auto& run : runs)
+            std::filesystem::remove(run, error);
+    }
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    void push(const Record& record) {
+        if (buffer.capacity() == 0) buffer.reserve(runCapacity);
+        buffer.push_back(record);
+        if (buffer.size() == runCapacity) spill();
+    }
+
+    template<typename F>
+    void merge(F&& consumer) {
+        if (runs.empty()) {
+            std::ranges::sort(buffer);
+            for (const auto& record : buffer)
+                consumer(record);
+            return;
+        }
+        spill();
+        std::vector<Record>().swap(buffer);
+
+        struct RunReader {
+            std::ifstream stream;
+            std::vector<Record> values;
+            size_t position = 0;
+
+            bool refill(size_t amount) {
+                values.resize(amount);
+                stream.read((char*)values.data(), amount * sizeof(Record));
+                values.resize(stream.gcount() / sizeof(Record));
+                position = 0;
+                return !values.empty();
+            }
+        };
+        const size_t readAmount = std::max<size_t>(1u, runCapacity / runs.size());
+        std::vector<RunReader> readers(runs.size());
+        using Head = std::pair<Record, size_t>;
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            readers[i].stream.open(runs[i], std::ios::binary);
+            if (!readers[i].stream) throw std::runtime_error("Could not read sort run!");
+            if (readers[i].refill(readAmount)) heads.emplace(readers[i].values[0], i);
+        }
+        while (!heads.empty()) {
+            const auto [record, run] = heads.top();
+            heads.pop();
+            consumer(record);
+            auto& reader = readers[run];
+            if (++reader.position == reader.values.size() && !reader.refill(readAmount))
+                continue;
+            heads.emplace(reader.values[reader.position], run);
+        }
+    }
+
+private:
+    void spill() {
+        if (buffer.empty()) return;
+        std::ranges::sort(buffer);
+        const auto run = directory / (name + "_" + std::to_string(runs.size()) + ".run");
+        std::ofstream stream(run, std::ios::binary | std::ios::trunc);
+        stream.write((const char*)buffer.data(), buffer.size() * sizeof(Record));
+        runs.push_back(run);
+        if (!stream) throw std::runtime_error("Could not write sort run!");
+        buffer.clear();
+    }
+};
+
+struct FaceRecord {
+    VertIndex corners[3];
+    TetIndex tetrahedron;
+
+    auto operator<=>(const FaceRecord&) const = default;
+};
+
+struct NeighbourRecord {
+    TetIndex tetrahedron;
+    TetIndex neighbour;
+
+    auto operator<=>(const NeighbourRecord&) const = default;
+};
+
+inline void pushFaces(ExternalSorter<FaceRecord>& faces, const Tetrahedron& tetrahedron, TetIndex index) {
+    static constexpr size_t FACES[4][3] = { { 0, 1, 2 }, { 0, 1, 3 }, { 0, 2, 3 }, { 1, 2, 3 } };
+    for (const auto& face : FACES)
+    {
+        FaceRecord record{ { tetrahedron.indices[face[0]], tetrahedron.indices[face[1]], tetrahedron.indices[face[2]] }, index };
+        std::ranges::sort(record.corners);
+        faces.push(record);
+    }
+}
+
+// Matches equal faces in the sorted face stream and writes the face neighbours of every tetrahedron
+// as 4 uint32 (UINT32_MAX on the boundary) to adjacencyFile. Returns the amount of boundary faces
+inline uint64_t writeFaceAdjacency(ExternalSorter<FaceRecord>& faces, uint64_t tetrahedronAmount, const std::string& adjacencyFile,
+    const std::filesystem::path& temporaryDirectory, size_t memoryBudget) {
+    ExternalSorter<NeighbourRecord> neighbours(temporaryDirectory, memoryBudget);
+    uint64_t boundaryFaces = 0;
+    uint64_t nonManifoldFaces = 0;
+    std::optional<FaceRecord> previous;
+    size_t sharing = 0;
+    faces.merge([&](const FaceRecord& face) {
+        if (previous && std::ranges::equal(previous->corners, face.corners)) {
+            if (++sharing == 2) {
+                neighbours.push({ previous->tetrahedron, face.tetrahedron });
+                neighbours.push({ face.tetrahedron, previous->tetrahedron });
+            }
+            else {
+                nonManifoldFaces++;
+            }
+            return;
+        }
+        boundaryFaces += sharing == 1;
+        previous = face;
+        sharing = 1;
+        });
+    boundaryFaces += sharing == 1;
+    if (nonManifoldFaces != 0)
+        std::cout << "Warning: " << nonManifoldFaces << " faces are shared by more than two tetrahedrons in " << adjacencyFile << std::endl;
+
+    std::ofstream adjacency(adjacencyFile, std::ios::binary | std::ios::trunc);
+    std::array<TetIndex, 4> row;
+    row.fill(std::numeric_limits<TetIndex>::max());
+    size_t used = 0;
+    uint64_t tetrahedron = 0;
+    const auto flushUntil = [&](uint64_t until) {
+        for (; tetrahedron < until; tetrahedron++)
+        {
+            adjacency.write((const char*)row.data(), sizeof(row));
+            row.fill(std::numeric_limits<TetIndex>::max());
+            used = 0;
+        }
+    };
+    neighbours.merge([&](const NeighbourRecord& record) {
+        flushUntil(record.tetrahedron);
+        if (used < row.size()) row[used++] = record.neighbour;
+        });
+    flushUntil(tetrahedronAmount);
+    if (!adjacency) throw std::runtime_error("Could not write adjacency file!");
+    return boundaryFaces;
+}
+
+// Tetrahedrons per cluster of the culling stage
+constexpr size_t CLUSTER_SIZE = 128;
+
+// Same layout as ClusterBounds in shader/model.glsl
+struct ClusterBounds {
+    glm::vec4 lower;
+    glm::vec4 upper;
+};
+
+// Sizes of everything uploaded for one model. The staging buffer is laid out as
+// vertices | tetrahedrons | LOD_COUNT visibility states | LOD tetrahedrons of all levels | LOD changes of all levels | face neighbours |
+// cluster bounds | cluster of every tetrahedron
+struct MeshLayout {
+    uint64_t vertexAmount = 0;
+    uint64_t tetrahedronAmount = 0;
+    uint64_t clusterAmount = 0;
+    std::array<uint64_t, LOD_COUNT> lodAmount{};
+    std::array<uint64_t, LOD_COUNT> lodUpdateAmount{};
+    AABB aabb;
+
+    size_t vertexByteSize() const { return vertexAmount * sizeof(glm::vec4); }
+    size_t tetrahedronByteSize() const { return tetrahedronAmount * sizeof(Tetrahedron); }
+    size_t stateSize() const { return (tetrahedronAmount / sizeof(uint32_t) + 1) * sizeof(uint32_t); }
+    size_t lodDataOffset() const { return vertexByteSize() + tetrahedronByteSize() + LOD_COUNT * stateSize(); }
+    size_t lodChangeOffset() const {
+        size_t offset = lodDataOffset();
+        for (const auto amount : lodAmount) offset += amount * sizeof(LODTetrahedron);
+        return offset;
+    }
+    size_t faceNeighbourByteSize() const { return tetrahedronAmount * sizeof(std::array<TetIndex, 4>); }
+    size_t faceNeighbourOffset() const {
+        size_t offset = lodChangeOffset();
+        for (const auto amount : lodUpdateAmount) offset += amount * sizeof(LODLevelChange);
+        return offset;
+    }
+    size_t clusterBoundsByteSize() const { return clusterAmount * sizeof(ClusterBounds); }
+    size_t clusterBoundsOffset() const { return faceNeighbourOffset() + faceNeighbourByteSize(); }
+    size_t clusterByteSize() const { return tetrahedronAmount * sizeof(uint32_t); }
+    size_t clusterOffset() const { return clusterBoundsOffset() + clusterBoundsByteSize(); }
+    size_t totalSize() const { return clusterOffset() + clusterByteSize(); }
+};
+
+constexpr TetIndex NO_NEIGHBOUR = std::numeric_limits<TetIndex>::max();
+// Entry i of a tetrahedron is the neighbour across the face opposite of its vertex i, NO_NEIGHBOUR on the boundary
+using FaceNeighbours = std::vector<std::array<TetIndex, 4>>;
+
+struct Clusters {
+    std::vector<ClusterBounds> bounds;
+    std::vector<uint32_t> clusterOf;
+};
+
+struct GeneratedMesh {
+    MeshLayout layout;
+    std::vector<glm::vec4> vertices;
+    std::vector<Tetrahedron> tetrahedrons;
+    std::array<LODLevel, LOD_COUNT> levels;
+    FaceNeighbours neighbours;
+    Clusters clusters;
+};
+
+// Two counting passes over tetrahedra: the first one sizes every row, the second one fills it.
+// Both run in parallel, a row only depends on the vertex to tetrahedron incidence
+inline TetGraph buildTetGraph(const std::vector<Tetrahedron>& tetrahedrons, const VertexIncidence& vertexIncidence) {
+    const auto& incidenceOffsets = vertexIncidence.offsets;
+    const auto& incidence = vertexIncidence.tetrahedrons;
+
+    // Counts the shared vertices of every neighbour in a small per worker hash table sized to the gathered
+    // incidence rows, so memory stays bounded by the largest neighbourhood. Only the touched slots are reset
+    struct Scratch {
+        std::vector<TetIndex> keys;
+        std::vector<uint8_t> shared;
+        std::vector<uint32_t> touched;
+    };
+    constexpr auto empty = std::numeric_limits<TetIndex>::max();
+    std::vector<Scratch> scratches(std::min(amountOfWorkers(), std::max<size_t>(tetrahedrons.size(), 1)));
+    const auto forEachNeighbour = [&](Scratch& scratch, TetIndex tetrahedron, auto&& function) {
+        size_t gathered = 0;
+        for (const auto vertex : tetrahedrons[tetrahedron].indices) gathered += incidenceOffsets[vertex + 1] - incidenceOffsets[vertex];
+        if (scratch.keys.size() < 2 * gathered) {
+            scratch.keys.assign(std::bit_ceil(2 * gathered), empty);
+            scratch.shared.assign(scratch.keys.size(), 0);
+        }
+        const auto mask = scratch.keys.size() - 1;
+        for (const auto vertex : tetrahedrons[tetrahedron].indices) {
+            for (auto i = incidenceOffsets[vertex]; i < incidenceOffsets[vertex + 1]; i++) {
+                const auto other = incidence[i];
+                if (other == tetrahedron) continue;
+                auto slot = (other * 2654435761u) & mask;
+                while (scratch.keys[slot] != empty && scratch.keys[slot] != other) slot = (slot + 1) & mask;
+                if (scratch.keys[slot] == empty) {
+                    scratch.keys[slot] = other;
+                    scratch.touched.push_back((uint32_t)slot);
+                }
+                scratch.shared[slot]++;
+            }
+        }
+        for (const auto slot : scratch.touched) {
+            assert(scratch.shared[slot] < 4);
+            function(scratch.keys[slot], (EdgeType)scratch.shared[slot]);
+            scratch.keys[slot] = empty;
+            scratch.shared[slot] = 0;
+        }
+        scratch.touched.clear();
+    };
+
+    TetGraph graph;
+    graph.offsets.assign(tetrahedrons.size() + 1, 0);
+    parallelFor(tetrahedrons.size(), [&](size_t worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint64_t amount = 0;
+            forEachNeighbour(scratches[worker], (TetIndex)i, [&](TetIndex, EdgeType) { amount++; });
+            graph.offsets[i + 1] = amount;
+        }
+    });
+    std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+
+    graph.connections.resize(graph.offsets.back());
+    parallelFor(tetrahedrons.size(), [&](size_t worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            auto output = graph.offsets[i];
+            forEachNeighbour(scratches[worker], (TetIndex)i, [&](TetIndex other, EdgeType type) { graph.connections[output++] = { other, type }; });
+            assert(output == graph.offsets[i + 1]);
+        }
+    });
+    return graph;
+}
+
+// Outer tetrahedra and their direct neighbours are never used as prey -> 3.4 Boundary preservation tests
+inline std::vector<char> findCollapsible(TetGraph& graph) {
+    static constexpr size_t SIDES_PER_TETRAHEDRON = 4;
+    std::vector<char> allowedToTake(graph.size(), true);
+    for (size_t i = 0; i < graph.size(); i++)
+    {
+        const auto& connected = graph[i];
+        size_t amount = 0;
+        for (const auto& [other, type] : connected) {
+            if (type == EdgeType::Face) amount++;
+            if (amount == SIDES_PER_TETRAHEDRON) break;
+        }
+        if (amount == SIDES_PER_TETRAHEDRON) {
+            continue;
+        }
+        allowedToTake[i] = false;
+        for (const auto& [other, type] : connected) {
+            allowedToTake[other] = false;
+        }
+    }
+    return allowedToTake;
+}
+
+inline FaceNeighbours buildFaceNeighbours(const std::vector<Tetrahedron>& tetrahedrons, const VertexIncidence& incidence) {
+    FaceNeighbours neighbours(tetrahedrons.size());
+    parallelFor(tetrahedrons.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& indices = tetrahedrons[i].indices;
+            for (size_t face = 0; face < 4; face++) {
+                const VertIndex a = indices[(face + 1) % 4], b = indices[(face + 2) % 4], c = indices[(face + 3) % 4];
+                neighbours[i][face] = NO_NEIGHBOUR;
+                for (const auto other : incidence[a]) {
+                    if (other == i) continue;
+                    const auto& otherIndices = tetrahedrons[other].indices;
+                    if (std::ranges::find(otherIndices, b) != std::end(otherIndices) && std::ranges::find(otherIndices, c) != std::end(otherIndices)) {
+                        neighbours[i][face] = other;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    return neighbours;
+}
+
+// Spreads the lower 10 bits of value to every third bit
+inline uint32_t spreadBits(uint32_t value) {
+    value &= 0x3FFu;
+    value = (value | (value << 16)) & 0x030000FFu;
+    value = (value | (value << 8)) & 0x0300F00Fu;
+    value = (value | (value << 4)) & 0x030C30C3u;
+    value = (value | (value << 2)) & 0x09249249u;
+    return value;
+}
+
+// Runs of CLUSTER_SIZE tetrahedrons in Morton order of their barycentres. The bounds also hold every position the
+// corners of a cluster reach while lod.comp morphs them and every vertex the LOD changes swap in, so culling a
+// cluster stays conservative on every level. vertices and tetrahedrons are the ones before the LOD chain
+inline Clusters buildClusters(const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons, const AABB& aabb,
+    const std::array<LODLevel, LOD_COUNT>& levels) {
+    const glm::vec3 extent = glm::max(aabb.max - aabb.min, glm::vec3(FLT_MIN));
+    std::vector<uint64_t> keys(tetrahedrons.size());
+    parallelFor(tetrahedrons.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto cell = glm::clamp((glm::vec3(barycentre(vertices, tetrahedrons[i])) - aabb.min) / extent, 0.0f, 1.0f) * 1023.0f;
+            const uint32_t code = spreadBits((uint32_t)cell.x) | (spreadBits((uint32_t)cell.y) << 1) | (spreadBits((uint32_t)cell.z) << 2);
+            keys[i] = ((uint64_t)code << 32) | i;
+        }
+    });
+    std::ranges::sort(keys);
+
+    // Positions every collapsed vertex passes through, only the few vertices of the preys get an entry
+    constexpr uint32_t NO_REACH = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> reachOf(vertices.size(), NO_REACH);
+    std::vector<AABB> reach;
+    const auto vertexBounds = [&](VertIndex vertex) {
+        const glm::vec3 position = vertices[vertex];
+        const AABB point{ position, position };
+        return reachOf[vertex] == NO_REACH ? point : extendAABB(point, reach[reachOf[vertex]]);
+    };
+    for (const auto& level : levels)
+    {
+        for (const auto& collapse : level.lodTetrahedrons)
+        {
+            const glm::vec3 next = collapse.next;
+            for (const auto vertex : collapse.tetrahedron.indices) {
+                if (reachOf[vertex] == NO_REACH) {
+                    reachOf[vertex] = (uint32_t)reach.size();
+                    reach.push_back({ next, next });
+                }
+                reach[reachOf[vertex]] = extendAABB(reach[reachOf[vertex]], { next, next });
+            }
+        }
+    }
+
+    Clusters clusters;
+    const size_t clusterAmount = (tetrahedrons.size() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    clusters.bounds.resize(clusterAmount);
+    clusters.clusterOf.resize(tetrahedrons.size());
+    std::vector<AABB> bounds(clusterAmount);
+    parallelFor(clusterAmount, [&](size_t, size_t begin, size_t end) {
+        for (size_t cluster = begin; cluster < end; cluster++) {
+            const size_t last = std::min(keys.size(), (cluster + 1) * CLUSTER_SIZE);
+            for (size_t i = cluster * CLUSTER_SIZE; i < last; i++) {
+                const auto tetrahedron = (TetIndex)(keys[i] & 0xFFFFFFFFu);
+                clusters.clusterOf[tetrahedron] = (uint32_t)cluster;
+                for (const auto vertex : tetrahedrons[tetrahedron].indices)
+                    bounds[cluster] = extendAABB(bounds[cluster], vertexBounds(vertex));
+            }
+        }
+    });
+    for (const auto& level : levels)
+        for (const auto& change : level.lodLevelChanges)
+        {
+            auto& changed = bounds[clusters.clusterOf[change.tetrahedronID]];
+            changed = extendAABB(changed, vertexBounds(change.newIndex));
+        }
+    for (size_t i = 0; i < clusterAmount; i++)
+        clusters.bounds[i] = { glm::vec4(bounds[i].min, 1.0f), glm::vec4(bounds[i].max, 1.0f) };
+    return clusters;
+}
+
+// 1 if eye is on the side of tetrahedron, -1 on the side of the neighbour and 0 in the plane of the face.
+// Both tetrahedrons of a face get the same plane, it is built from the corners sorted by index
+inline int eyeSide(const std::vector<glm::vec4>& vertices, const Tetrahedron& tetrahedron, size_t face, const glm::vec3& eye) {
+    std::array<VertIndex, 3> corners = { tetrahedron.indices[(face + 1) % 4], tetrahedron.indices[(face + 2) % 4], tetrahedron.indices[(face + 3) % 4] };
+    std::ranges::sort(corners);
+    const glm::vec3 a = vertices[corners[0]];
+    const glm::vec3 normal = glm::cross(glm::vec3(vertices[corners[1]]) - a, glm::vec3(vertices[corners[2]]) - a);
+    const float eyeDistance = glm::dot(normal, eye - a);
+    const float ownDistance = glm::dot(normal, glm::vec3(vertices[tetrahedron.indices[face]]) - a);
+    if (eyeDistance == 0.0f) return 0;
+    return (eyeDistance > 0.0f) == (ownDistance > 0.0f) ? 1 : -1;
+}
+
+// Reused between frames, only grows
+struct VisibilityWorkspace {
+    // Neighbours which have to be drawn first, EMITTED once the tetrahedron is in the order
+    std::vector<uint8_t> predecessors;
+    // Bit i is set if the neighbour across face i has to be drawn first
+    std::vector<uint8_t> waitsFor;
+    std::vector<TetIndex> sources;
+    std::vector<TetIndex> stack;
+    std::vector<float> depth;
+    static constexpr uint8_t EMITTED = std::numeric_limits<uint8_t>::max();
+};
+
+struct VisibilityStats {
+    size_t sources = 0;
+    // Tetrahedrons emitted with predecessors left, every one breaks a cycle of the front/behind graph
+    size_t cycleBreaks = 0;
+};
+
+inline float centroidDistance(const std::vector<glm::vec4>& vertices, const Tetrahedron& tetrahedron, const glm::vec3& eye) {
+    glm::vec3 centroid(0.0f);
+    for (const auto index : tetrahedron.indices)
+        centroid += glm::vec3(vertices[index]);
+    const auto offset = centroid * 0.25f - eye;
+    return glm::dot(offset, offset);
+}
+
+// Back to front order for eye after MPVONC (Williams 1992): the face shared by two tetrahedrons tells which one is
+// behind the other, the resulting graph is sorted topologically in O(n). Sources start in descending centroid distance,
+// which is what makes the order usable for non convex meshes. Cycles are broken by emitting the farthest tetrahedron
+// left. Classifying the faces runs on all workers, the traversal itself is sequential
+inline VisibilityStats visibilityOrder(const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons,
+    const FaceNeighbours& neighbours, const glm::vec3& eye, VisibilityWorkspace& workspace, std::span<TetIndex> order) {
+    assert(order.size() == tetrahedrons.size());
+    auto& predecessors = workspace.predecessors;
+    auto& waitsFor = workspace.waitsFor;
+    predecessors.resize(tetrahedrons.size());
+    waitsFor.resize(tetrahedrons.size());
+    parallelFor(tetrahedrons.size(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint8_t mask = 0;
+            for (size_t face = 0; face < 4; face++)
+                if (neighbours[i][face] != NO_NEIGHBOUR && eyeSide(vertices, tetrahedrons[i], face, eye) > 0) mask |= 1u << face;
+            waitsFor[i] = mask;
+            predecessors[i] = (uint8_t)std::popcount(mask);
+        }
+    });
+
+    VisibilityStats stats;
+    auto& sources = workspace.sources;
+    auto& depth = workspace.depth;
+    sources.clear();
+    for (TetIndex i = 0; i < tetrahedrons.size(); i++)
+        if (predecessors[i] == 0) sources.push_back(i);
+    stats.sources = sources.size();
+    depth.resize(tetrahedrons.size());
+    for (const auto source : sources)
+        depth[source] = centroidDistance(vertices, tetrahedrons[source], eye);
+    std::ranges::sort(sources, [&](TetIndex a, TetIndex b) { return depth[a] > depth[b]; });
+
+    size_t emitted = 0;
+    auto& stack = workspace.stack;
+    const auto traverse = [&](TetIndex start) {
+        predecessors[start] = VisibilityWorkspace::EMITTED;
+        stack.assign(1, start);
+        while (!stack.empty()) {
+            const auto current = stack.back();
+            stack.pop_back();
+            order[emitted++] = current;
+            for (size_t face = 0; face < 4; face++) {
+                const auto neighbour = neighbours[current][face];
+                if (neighbour == NO_NEIGHBOUR || predecessors[neighbour] == VisibilityWorkspace::EMITTED) continue;
+                // Decided from the side of the neighbour like the counting above, faces of degenerate tetrahedrons
+                // or shared by more than two tetrahedrons are not symmetric
+                const auto& back = neighbours[neighbour];
+                const auto backFace = (size_t)(std::ranges::find(back, current) - back.begin());
+                if (backFace == back.size() || !(waitsFor[neighbour] & (1u << backFace))) continue;
+                if (--predecessors[neighbour] == 0) {
+                    predecessors[neighbour] = VisibilityWorkspace::EMITTED;
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+    };
+    for (const auto source : sources)
+        if (predecessors[source] != VisibilityWorkspace::EMITTED) traverse(source);
+
+    if (emitted != tetrahedrons.size()) {
+        // Only the tetrahedrons in or behind cycles are left
+        sources.clear();
+        for (TetIndex i = 0; i < tetrahedrons.size(); i++)
+            if (predecessors[i] != VisibilityWorkspace::EMITTED) {
+                sources.push_back(i);
+                depth[i] = centroidDistance(vertices, tetrahedrons[i], eye);
+            }
+        std::ranges::sort(sources, [&](TetIndex a, TetIndex b) { return depth[a] > depth[b]; });
+        for (const auto source : sources)
+        {
+            if (predecessors[source] == VisibilityWorkspace::EMITTED) continue;
+            stats.cycleBreaks++;
+            traverse(source);
+        }
+    }
+    assert(emitted == tetrahedrons.size());
+    return stats;
+}
+
+// Shared faces whose tetrahedrons are drawn in the wrong order for eye, 0 for a correct back to front order
+inline size_t countOrderViolations(const std::vector<glm::vec4>& vertices, const std::vector<Tetrahedron>& tetrahedrons,
+    const FaceNeighbours& neighbours, const glm::vec3& eye, std::span<const TetIndex> order) {
+    std::vector<TetIndex> position(tetrahedrons.size());
+    for (TetIndex i = 0; i < order.size(); i++)
+        position[order[i]] = i;
+    std::atomic<size_t> violations = 0;
+    parallelFor(tetrahedrons.size(), [&](size_t, size_t begin, size_t end) {
+        size_t found = 0;
+        for (size_t i = begin; i < end; i++)
+            for (size_t face = 0; face < 4; face++) {
+                const auto neighbour = neighbours[i][face];
+                // Every face is checked from the tetrahedron behind it
+                if (neighbour != NO_NEIGHBOUR && eyeSide(vertices, tetrahedrons[i], face, eye) < 0 && position[i] > position[neighbour])
+                    found++;
+            }
+        violations += found;
+    });
+    return violations;
+}
+
+// CPU copy of a model for visibilityOrder, the face neighbours are built on first use if the mesh cache had none
+struct VisibilityMesh {
+    std::vector<glm::vec4> vertices;
+    std::vector<Tetrahedron> tetrahedrons;
+    FaceNeighbours neighbours;
+    VisibilityWorkspace workspace;
+    std::vector<TetIndex> order;
+    VisibilityStats stats;
+
+    std::span<const TetIndex> update(const glm::vec3& eye) {
+        if (neighbours.empty() && !tetrahedrons.empty())
+            neighbours = buildFaceNeighbours(tetrahedrons, buildVertexIncidence(tetrahedrons, vertices.size()));
+        order.resize(tetrahedrons.size());
+        stats = visibilityOrder(vertices, tetrahedrons, neighbours, eye, workspace, order);
+        return order;
+    }
+};
+
+// Generates all levels on copies of the mesh, the graph and workspace are updated along the way
+inline std::array<LODLevel, LOD_COUNT> generateLODChain(const MeshData& mesh, TetGraph& graph, LODWorkspace& workspace,
+    const std::vector<char>& allowedToTake, const std::string& name, Heuristic heuristic, PreySelection selection) {
+    std::array<LODLevel, LOD_COUNT> levelToGenerate;
+    levelToGenerate[0] = defaultLODLevel(graph);
+    auto modifiableLODVertex = mesh.vertices;
+    auto modifiableLODIndex = mesh.tetrahedrons;
+    CollapseQueue collapseQueue;
+    for (size_t i = 1; i < LOD_COUNT; i++)
+    {
+        LODGenerateInfo generateInfo{
+            levelToGenerate[i - 1].usageAfter, allowedToTake, levelToGenerate[i - 1].lodTetrahedrons, graph, workspace,
+            (LodLevelFlag)i, heuristic, name, selection, &collapseQueue };
+        levelToGenerate[i] = loadLODLevel(generateInfo, modifiableLODVertex, modifiableLODIndex);
+    }
+    return levelToGenerate;
+}
+
+inline GeneratedMesh generateMesh(const std::string& vtkFile) {
+    const auto startTimeParsing = std::chrono::steady_clock::now();
+    MeshData mesh = parseMesh(vtkFile);
+    const auto& vertices = mesh.vertices;
+    const auto& tetrahedrons = mesh.tetrahedrons;
+    const auto durationParsing = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeParsing);
+    std::cout << "Parsing time " << durationParsing.count() / (1e6f) << " ms for " << vtkFile << " (" << vertices.size()
+        << " vertices, " << tetrahedrons.size() << " tetrahedrons)" << std::endl;
+
+    const auto startTimeWelding = std::chrono::steady_clock::now();
+    const auto merged = weldVertices(mesh);
+    const auto durationWelding = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeWelding);
+    std::cout << "Welding time " << durationWelding.count() / (1e6f) << " ms for " << vtkFile << " (" << merged
+        << " vertices merged)" << std::endl;
+
+    const auto startTimeGraph = std::chrono::steady_clock::now();
+    LODWorkspace workspace;
+    workspace.incidence = buildVertexIncidence(tetrahedrons, vertices.size());
+    TetGraph tetrahedronGraph = buildTetGraph(tetrahedrons, workspace.incidence);
+    const auto durationGraph = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeGraph);
+    std::cout << "Graph time " << durationGraph.count() / (1e6f) << " ms for " << vtkFile << " ("
+        << tetrahedronGraph.connections.size() << " connections, " << tetrahedronGraph.memoryUsage() / (1024.0f * 1024.0f) << " MiB)" << std::endl;
+
+    const auto allowedToTake = findCollapsible(tetrahedronGraph);
+    // Before the LOD chain relocates the incidence
+    auto neighbours = buildFaceNeighbours(tetrahedrons, workspace.incidence);
+
+    const auto startTimeLOD = std::chrono::steady_clock::now();
+    auto levelToGenerate = generateLODChain(mesh, tetrahedronGraph, workspace, allowedToTake, vtkFile,
+        Heuristic::VolumeError, PreySelection::IndependentSet);
+    const auto durationLOD = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeLOD);
+    std::cout << "LOD time " << durationLOD.count() / (1e6f) << " ms for " << vtkFile << std::endl;
+
+    const auto startTimeClusters = std::chrono::steady_clock::now();
+    auto clusters = buildClusters(vertices, tetrahedrons, mesh.aabb, levelToGenerate);
+    const auto durationClusters = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeClusters);
+    std::cout << "Cluster time " << durationClusters.count() / (1e6f) << " ms for " << vtkFile << " (" << clusters.bounds.size()
+        << " clusters)" << std::endl;
+
+    GeneratedMesh generated{ {}, std::move(mesh.vertices), std::move(mesh.tetrahedrons), std::move(levelToGenerate), std::move(neighbours),
+        std::move(clusters) };
+    auto& layout = generated.layout;
+    layout.vertexAmount = generated.vertices.size();
+    layout.tetrahedronAmount = generated.tetrahedrons.size();
+    layout.clusterAmount = generated.clusters.bounds.size();
+    layout.aabb = mesh.aabb;
+    for (size_t i = 0; i < LOD_COUNT; i++)
+    {
+        layout.lodAmount[i] = generated.levels[i].lodTetrahedrons.size();
+        layout.lodUpdateAmount[i] = generated.levels[i].lodLevelChanges.size();
+    }
+    return generated;
+}
+
+// Writes the staging layout described by MeshLayout, mapped must hold layout.totalSize() bytes
+inline void writeStaging(const GeneratedMesh& generated, char* mapped) {
+    const auto& layout = generated.layout;
+    std::copy(generated.vertices.begin(), generated.vertices.end(), (glm::vec4*)mapped);
+    std::copy(generated.tetrahedrons.begin(), generated.tetrahedrons.end(), (Tetrahedron*)(mapped + layout.vertexByteSize()));
+    char* nextPointer = mapped + layout.vertexByteSize() + layout.tetrahedronByteSize();
+    LODTetrahedron* nextPointerData = (LODTetrahedron*)(mapped + layout.lodDataOffset());
+    for (const auto& lod : generated.levels) {
+        std::fill(std::copy(lod.usageAfter.begin(), lod.usageAfter.end(), nextPointer), nextPointer + layout.stateSize(), 0);
+        std::copy(lod.lodTetrahedrons.begin(), lod.lodTetrahedrons.end(), nextPointerData);
+        nextPointer += layout.stateSize();
+        nextPointerData += lod.lodTetrahedrons.size();
+    }
+    LODLevelChange* nextChanged = (LODLevelChange*)nextPointerData;
+    for (const auto& lod : generated.levels) {
+        std::copy(lod.lodLevelChanges.begin(), lod.lodLevelChanges.end(), nextChanged);
+        nextChanged += lod.lodLevelChanges.size();
+    }
+    std::copy(generated.neighbours.begin(), generated.neighbours.end(), (std::array<TetIndex, 4>*)(mapped + layout.faceNeighbourOffset()));
+    std::memcpy(mapped + layout.clusterBoundsOffset(), generated.clusters.bounds.data(), layout.clusterBoundsByteSize());
+    std::memcpy(mapped + layout.clusterOffset(), generated.clusters.clusterOf.data(), layout.clusterByteSize());
+}
+
+// Binary cache (.tetbin) next to the source file: header followed by the exact staging layout
+constexpr uint32_t MESH_CACHE_VERSION = 6;
+constexpr std::array<char, 8> MESH_CACHE_MAGIC = { 'T', 'E', 'T', 'B', 'I', 'N', '\0', '\0' };
+
+struct MeshCacheHeader {
+    std::array<char, 8> magic = MESH_CACHE_MAGIC;
+    uint32_t version = MESH_CACHE_VERSION;
+    uint32_t lodCount = LOD_COUNT;
+    uint64_t colapsingPerLevel = COLAPSING_PER_LEVEL;
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    MeshLayout layout;
+
+    bool matches(const MeshCacheHeader& other) const {
+        return magic == other.magic && version == other.version && lodCount == other.lodCount &&
+            colapsingPerLevel == other.colapsingPerLevel && sourceSize == other.sourceSize && sourceTime == other.sourceTime;
+    }
+};
+
+inline std::string meshCacheName(const std::string& vtkFile) {
+    return vtkFile + ".tetbin";
+}
+
+inline MeshCacheHeader meshCacheHeader(const std::string& vtkFile) {
+    MeshCacheHeader header;
+    header.sourceSize = std::filesystem::file_size(vtkFile);
+    header.sourceTime = std::filesystem::last_write_time(vtkFile).time_since_epoch().count();
+    return header;
+}
+
+// Returns the mapped cache if it was written for the current state of the source, otherwise nullptr
+inline std::unique_ptr<MappedFile> openMeshCache(const std::string& vtkFile, const MeshCacheHeader& expected) {
+    const auto cacheFile = meshCacheName(vtkFile);
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cacheFile, error)) return nullptr;
+    auto cache = std::make_unique<MappedFile>(cacheFile);
+    if (cache->size < sizeof(MeshCacheHeader)) return nullptr;
+    MeshCacheHeader header;
+    std::memcpy(&header, cache->data, sizeof(MeshCacheHeader));
+    if (!header.matches(expected)) return nullptr;
+    if (cache->size != sizeof(MeshCacheHeader) + header.layout.totalSize()) return nullptr;
+    return cache;
+}
+
+inline const MeshCacheHeader& cacheHeader(const MappedFile& cache) {
+    return *(const MeshCacheHeader*)cache.data;
+}
+
+// CPU copy for the face graph order out of data in the staging layout, vertices and tetrahedrons lead it
+inline std::shared_ptr<VisibilityMesh> visibilityMesh(const char* data, const MeshLayout& layout) {
+    auto mesh = std::make_shared<VisibilityMesh>();
+    const auto vertices = (const glm::vec4*)data;
+    mesh->vertices.assign(vertices, vertices + layout.vertexAmount);
+    const auto tetrahedrons = (const Tetrahedron*)(data + layout.vertexByteSize());
+    mesh->tetrahedrons.assign(tetrahedrons, tetrahedrons + layout.tetrahedronAmount);
+    const auto neighbours = (const std::array<TetIndex, 4>*)(data + layout.faceNeighbourOffset());
+    mesh->neighbours.assign(neighbours, neighbours + layout.tetrahedronAmount);
+    return mesh;
+}
+
+// From the mapped cache of vtkFile, nullptr if there is no cache for the current state of the source
+inline std::shared_ptr<VisibilityMesh> loadVisibilityMesh(const std::string& vtkFile) {
+    const auto cache = openMeshCache(vtkFile, meshCacheHeader(vtkFile));
+    if (!cache) return nullptr;
+    return visibilityMesh(cache->data + sizeof(MeshCacheHeader), cacheHeader(*cache).layout);
+}
+
+inline void writeMeshCache(const std::string& vtkFile, MeshCacheHeader header, const MeshLayout& layout, const char* data) {
+    header.layout = layout;
+    const auto cacheFile = meshCacheName(vtkFile);
+    const auto temporaryFile = cacheFile + ".tmp";
+    {
+        std::ofstream cache(temporaryFile, std::ios::binary | std::ios::trunc);
+        cache.write((const char*)&header, sizeof(MeshCacheHeader));
+        cache.write(data, layout.totalSize());
+        if (!cache) {
+            std::cout << "Warning: Could not write mesh cache " << cacheFile << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryFile, cacheFile, error);
+    if (error) {
+        std::cout << "Warning: Could not write mesh cache " << cacheFile << std::endl;
+        std::filesystem::remove(temporaryFile, error);
+    }
+}
+
+// Runs the whole CPU pipeline for one mesh and stores the result as its cache, returns the staging data
+inline std::vector<char> generateMeshCache(const std::string& vtkFile, const MeshCacheHeader& header, MeshLayout& layout) {
+    const auto generated = generateMesh(vtkFile);
+    layout = generated.layout;
+    std::vector<char> data(layout.totalSize());
+    writeStaging(generated, data.data());
+    writeMeshCache(vtkFile, header, layout, data.data());
+    return data;
+}
@@ -0,0 +1,407 @@
+#include "Util.hpp"
+#include "MeshCore.hpp"
+
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Tests of the device free mesh pipeline, run from the build directory so assets/ is next to the executable
+
+namespace {
+
+// Removes its directory with everything written into it
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    TemporaryDirectory() {
+        path = std::filesystem::temp_directory_path() / ("MeshCoreTest" + std::to_string(std::random_device()()));
+        std::filesystem::create_directories(path);
+    }
+    ~TemporaryDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+};
+
+void expectSameMesh(const MeshData& expected, const MeshData& actual) {
+    ASSERT_EQ(expected.vertices.size(), actual.vertices.size());
+    ASSERT_EQ(expected.tetrahedrons.size(), actual.tetrahedrons.size());
+    for (size_t i = 0; i < expected.vertices.size(); i++)
+        for (size_t axis = 0; axis < 4; axis++)
+            ASSERT_FLOAT_EQ(expected.vertices[i][axis], actual.vertices[i][axis]) << "vertex " << i;
+    for (size_t i = 0; i < expected.tetrahedrons.size(); i++)
+        for (size_t corner = 0; corner < 4; corner++)
+            ASSERT_EQ(expected.tetrahedrons[i].indices[corner], actual.tetrahedrons[i].indices[corner]) << "tetrahedron " << i;
+}
+
+// Legacy VTK with one triangle cell in front of the tetrahedrons, the parser has to drop it
+void writeLegacyVTK(const std::filesystem::path& file, const MeshData& mesh, bool binary) {
+    const auto bigEndian = [](uint32_t value) { return std::endian::native == std::endian::little ? byteSwap(value) : value; };
+    const auto write = [&](std::ofstream& output, const std::vector<uint32_t>& values) {
+        if (binary) {
+            std::vector<uint32_t> swapped(values.size());
+            std::ranges::transform(values, swapped.begin(), bigEndian);
+            output.write((const char*)swapped.data(), swapped.size() * sizeof(uint32_t));
+        }
+        else {
+            for (const auto value : values)
+                output << value << " ";
+        }
+        output << "\n";
+    };
+    std::ofstream output(file, std::ios::binary);
+    output << "# vtk DataFile Version 3.0\nMeshCoreTest\n" << (binary ? "BINARY" : "ASCII") << "\nDATASET UNSTRUCTURED_GRID\n";
+    output << "POINTS " << mesh.vertices.size() << " float\n";
+    if (binary) {
+        std::vector<uint32_t> values;
+        for (const auto& vertex : mesh.vertices)
+            for (size_t axis = 0; axis < 3; axis++)
+                values.push_back(std::bit_cast<uint32_t>(vertex[axis]));
+        write(output, values);
+    }
+    else {
+        output.precision(9);
+        for (const auto& vertex : mesh.vertices)
+            output << vertex.x << " " << vertex.y << " " << vertex.z << "\n";
+    }
+
+    const size_t cellAmount = mesh.tetrahedrons.size() + 1;
+    std::vector<uint32_t> cells = { 3, 0, 1, 2 };
+    for (const auto& tetrahedron : mesh.tetrahedrons)
+        cells.insert(cells.end(), { 4, tetrahedron.indices[0], tetrahedron.indices[1], tetrahedron.indices[2], tetrahedron.indices[3] });
+    output << "CELLS " << cellAmount << " " << cells.size() << "\n";
+    write(output, cells);
+    std::vector<uint32_t> types(cellAmount, VTK_TETRA);
+    types[0] = 5;
+    output << "CELL_TYPES " << cellAmount << "\n";
+    write(output, types);
+}
+
+// Cube grid with every cube split into the six tetrahedrons along its main diagonal, as in MeshBenchmark
+MeshData gridMesh(size_t cubesPerAxis) {
+    MeshData mesh;
+    const size_t pointsPerAxis = cubesPerAxis + 1;
+    const auto pointIndex = [=](size_t x, size_t y, size_t z) { return (VertIndex)((z * pointsPerAxis + y) * pointsPerAxis + x); };
+    for (size_t z = 0; z < pointsPerAxis; z++)
+        for (size_t y = 0; y < pointsPerAxis; y++)
+            for (size_t x = 0; x < pointsPerAxis; x++)
+                mesh.vertices.emplace_back((float)x / cubesPerAxis, (float)y / cubesPerAxis, (float)z / cubesPerAxis, 1.0f);
+    static constexpr std::array<std::array<size_t, 3>, 6> AXIS_ORDERS = { {
+        { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } } };
+    for (size_t z = 0; z < cubesPerAxis; z++)
+        for (size_t y = 0; y < cubesPerAxis; y++)
+            for (size_t x = 0; x < cubesPerAxis; x++)
+                for (const auto& order : AXIS_ORDERS)
+                {
+                    std::array<size_t, 3> corner = { x, y, z };
+                    Tetrahedron tetrahedron;
+                    tetrahedron.indices[0] = pointIndex(corner[0], corner[1], corner[2]);
+                    for (size_t i = 0; i < 3; i++) {
+                        corner[order[i]]++;
+                        tetrahedron.indices[i + 1] = pointIndex(corner[0], corner[1], corner[2]);
+                    }
+                    mesh.tetrahedrons.push_back(tetrahedron);
+                }
+    mesh.aabb = { glm::vec3(0.0f), glm::vec3(1.0f) };
+    return mesh;
+}
+
+}
+
+TEST(Parsing, VertexTetrahedronAndTetGenAgree) {
+    const auto mesh = parseMesh("assets/bunny.vtk");
+    EXPECT_EQ(mesh.vertices.size(), 12341u);
+    EXPECT_EQ(mesh.tetrahedrons.size(), 61145u);
+    expectSameMesh(mesh, parseMesh("assets/bunny.tet"));
+}
+
+TEST(Parsing, VertexTetrahedronBounds) {
+    const auto mesh = parseMesh("assets/cube.vtk");
+    ASSERT_EQ(mesh.vertices.size(), 9u);
+    EXPECT_EQ(mesh.tetrahedrons.size(), 12u);
+    for (size_t axis = 0; axis < 3; axis++) {
+        EXPECT_FLOAT_EQ(mesh.aabb.min[axis], -1.0f);
+        EXPECT_FLOAT_EQ(mesh.aabb.max[axis], 1.0f);
+    }
+    for (const auto& tetrahedron : mesh.tetrahedrons)
+        for (const auto index : tetrahedron.indices)
+            EXPECT_LT(index, mesh.vertices.size());
+}
+
+TEST(Parsing, LegacyVTKAsciiAndBinary) {
+    const TemporaryDirectory directory;
+    const auto mesh = parseMesh("assets/bunny.vtk");
+    for (const bool binary : { false, true })
+    {
+        const auto file = directory.path / (binary ? "binary.vtk" : "ascii.vtk");
+        writeLegacyVTK(file, mesh, binary);
+        SCOPED_TRACE(file.string());
+        expectSameMesh(mesh, parseMesh(file.string()));
+    }
+}
+
+TEST(Parsing, RejectsUnknownEncoding) {
+    const TemporaryDirectory directory;
+    const auto file = directory.path / "broken.vtk";
+    std::ofstream(file) << "# vtk DataFile Version 3.0\nMeshCoreTest\nXML\nDATASET UNSTRUCTURED_GRID\n";
+    EXPECT_THROW(parseMesh(file.string()), std::runtime_error);
+}
+
+TEST(Parsing, RejectsVertexIndexOutOfRange) {
+    const TemporaryDirectory directory;
+    const auto vertexTetrahedron = directory.path / "broken.vtk";
+    std::ofstream(vertexTetrahedron) << "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\nt 0 1 2 4\n";
+    const auto tetGen = directory.path / "broken.tet";
+    std::ofstream(tetGen) << "4 vertices\n1 tets\n0 0 0\n1 0 0\n0 1 0\n0 0 1\n4 0 1 2 4\n";
+    for (const auto& file : { vertexTetrahedron, tetGen })
+        EXPECT_THROW(parseMesh(file.string()), std::runtime_error) << file;
+}
+
+TEST(Welding, MergesDuplicatedPoints) {
+    // Two tetrahedrons sharing a face, every one with its own copy of the three shared corners
+    MeshData mesh;
+    mesh.vertices = { { 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 1 },
+                      { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 1 }, { 1, 1, 1, 1 } };
+    mesh.tetrahedrons = { { 0, 1, 2, 3 }, { 4, 5, 6, 7 } };
+    EXPECT_EQ(weldVertices(mesh), 3u);
+    ASSERT_EQ(mesh.vertices.size(), 5u);
+    ASSERT_EQ(mesh.tetrahedrons.size(), 2u);
+    const auto& first = mesh.tetrahedrons[0].indices;
+    const auto& second = mesh.tetrahedrons[1].indices;
+    for (size_t i = 0; i < 3; i++)
+        EXPECT_EQ(first[i + 1], second[i]);
+    EXPECT_FLOAT_EQ(mesh.vertices[second[3]].x, 1.0f);
+    EXPECT_FLOAT_EQ(mesh.vertices[second[3]].y, 1.0f);
+}
+
+TEST(Welding, KeepsDistinctPointsAndDropsCollapsedTetrahedrons) {
+    MeshData mesh;
+    mesh.vertices = { { 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 1 }, { 1e-3f, 0, 0, 1 }, { 0, 0, 0, 1 } };
+    mesh.tetrahedrons = { { 0, 1, 2, 3 }, { 4, 1, 2, 3 }, { 0, 5, 2, 3 } };
+    EXPECT_EQ(weldVertices(mesh), 1u);
+    EXPECT_EQ(mesh.vertices.size(), 5u);
+    EXPECT_EQ(mesh.tetrahedrons.size(), 2u);
+}
+
+TEST(Graph, MatchesBruteForceReference) {
+    for (const auto& mesh : { parseMesh("assets/cube.vtk"), gridMesh(3) })
+    {
+        const auto incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+        auto graph = buildTetGraph(mesh.tetrahedrons, incidence);
+        ASSERT_EQ(graph.size(), mesh.tetrahedrons.size());
+        for (TetIndex i = 0; i < mesh.tetrahedrons.size(); i++)
+        {
+            std::set<std::pair<TetIndex, EdgeType>> expected;
+            for (TetIndex j = 0; j < mesh.tetrahedrons.size(); j++)
+            {
+                if (i == j) continue;
+                uint32_t shared = 0;
+                for (const auto index : mesh.tetrahedrons[i].indices)
+                    shared += std::ranges::count(mesh.tetrahedrons[j].indices, index);
+                if (shared != 0) expected.emplace(j, (EdgeType)shared);
+            }
+            std::set<std::pair<TetIndex, EdgeType>> actual;
+            for (const auto& [other, type] : graph[i])
+                actual.emplace(other, type);
+            EXPECT_EQ(graph[i].size(), actual.size()) << "duplicated connection of " << i;
+            EXPECT_EQ(expected, actual) << "row " << i;
+        }
+    }
+}
+
+TEST(MeshCache, RoundTripAndStaleSource) {
+    const TemporaryDirectory directory;
+    const auto file = (directory.path / "cube.vtk").string();
+    std::filesystem::copy_file("assets/cube.vtk", file);
+
+    const auto header = meshCacheHeader(file);
+    EXPECT_EQ(openMeshCache(file, header), nullptr);
+    MeshLayout layout;
+    const auto generated = generateMeshCache(file, header, layout);
+    ASSERT_EQ(generated.size(), layout.totalSize());
+
+    const auto cache = openMeshCache(file, meshCacheHeader(file));
+    ASSERT_NE(cache, nullptr);
+    const auto& cached = cacheHeader(*cache).layout;
+    EXPECT_EQ(cached.vertexAmount, layout.vertexAmount);
+    EXPECT_EQ(cached.tetrahedronAmount, layout.tetrahedronAmount);
+    EXPECT_EQ(cached.clusterAmount, layout.clusterAmount);
+    EXPECT_EQ(cached.lodAmount, layout.lodAmount);
+    EXPECT_EQ(cached.lodUpdateAmount, layout.lodUpdateAmount);
+    ASSERT_EQ(cache->size, sizeof(MeshCacheHeader) + generated.size());
+    EXPECT_TRUE(std::equal(generated.begin(), generated.end(), cache->data + sizeof(MeshCacheHeader)));
+
+    // A changed source invalidates the cache even though the cache file is still there
+    std::ofstream(file, std::ios::app) << "\n";
+    EXPECT_NE(meshCacheHeader(file).sourceSize, header.sourceSize);
+    EXPECT_EQ(openMeshCache(file, meshCacheHeader(file)), nullptr);
+    EXPECT_TRUE(std::filesystem::exists(meshCacheName(file)));
+}
+
+TEST(MeshCache, RejectsTruncatedCache) {
+    const TemporaryDirectory directory;
+    const auto file = (directory.path / "cube.vtk").string();
+    std::filesystem::copy_file("assets/cube.vtk", file);
+    const auto header = meshCacheHeader(file);
+    MeshLayout layout;
+    generateMeshCache(file, header, layout);
+    std::filesystem::resize_file(meshCacheName(file), sizeof(MeshCacheHeader) + layout.totalSize() - 1);
+    EXPECT_EQ(openMeshCache(file, header), nullptr);
+}
+
+TEST(Visibility, GridOrderHasNoViolations) {
+    const auto mesh = gridMesh(8);
+    const auto incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+    const auto neighbours = buildFaceNeighbours(mesh.tetrahedrons, incidence);
+    VisibilityWorkspace workspace;
+    std::vector<TetIndex> order(mesh.tetrahedrons.size());
+    for (const auto& eye : { glm::vec3(2.3f, 1.7f, 2.9f), glm::vec3(-1.3f, 0.4f, 0.6f), glm::vec3(0.45f, -2.0f, 3.1f) })
+    {
+        visibilityOrder(mesh.vertices, mesh.tetrahedrons, neighbours, eye, workspace, order);
+        EXPECT_EQ(countOrderViolations(mesh.vertices, mesh.tetrahedrons, neighbours, eye, order), 0u);
+        auto sorted = order;
+        std::ranges::sort(sorted);
+        for (TetIndex i = 0; i < sorted.size(); i++)
+            ASSERT_EQ(sorted[i], i) << "order is no permutation";
+    }
+}
+
+// Preys are taken from the previous level, never from the boundary, and no two preys of a level share
+// a neighbour, for every combination of heuristic and selection
+TEST(LOD, PreysAreIndependentAndInner) {
+    const auto mesh = gridMesh(10);
+    const auto onSurface = [](const glm::vec4& vertex) {
+        for (size_t axis = 0; axis < 3; axis++)
+            if (vertex[axis] == 0.0f || vertex[axis] == 1.0f) return true;
+        return false;
+    };
+    for (const auto heuristic : { Heuristic::Random, Heuristic::VolumeError })
+        for (const auto selection : { PreySelection::Greedy, PreySelection::IndependentSet })
+        {
+            SCOPED_TRACE("heuristic " + std::to_string((int)heuristic) + ", selection " + std::to_string((int)selection));
+            LODWorkspace workspace;
+            workspace.incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+            auto graph = buildTetGraph(mesh.tetrahedrons, workspace.incidence);
+            const auto allowedToTake = findCollapsible(graph);
+            auto vertices = mesh.vertices;
+            auto tetrahedrons = mesh.tetrahedrons;
+            CollapseQueue collapseQueue;
+            auto previous = defaultLODLevel(graph);
+            for (size_t i = 1; i < LOD_COUNT; i++)
+            {
+                // A level only records the corners of its preys
+                std::map<std::array<VertIndex, 4>, TetIndex> present;
+                for (TetIndex t = 0; t < tetrahedrons.size(); t++)
+                    if (previous.usageAfter[t]) present.emplace(std::to_array(tetrahedrons[t].indices), t);
+                auto before = graph;
+                const auto verticesBefore = vertices;
+                LODGenerateInfo generateInfo{ previous.usageAfter, allowedToTake, previous.lodTetrahedrons, graph, workspace,
+                    (LodLevelFlag)i, heuristic, "grid", selection, &collapseQueue };
+                auto level = loadLODLevel(generateInfo, vertices, tetrahedrons);
+                if (i == 1) EXPECT_FALSE(level.lodTetrahedrons.empty());
+
+                std::vector<TetIndex> owner(tetrahedrons.size(), std::numeric_limits<TetIndex>::max());
+                for (const auto& lodTetrahedron : level.lodTetrahedrons)
+                {
+                    const auto found = present.find(std::to_array(lodTetrahedron.tetrahedron.indices));
+                    ASSERT_NE(found, present.end()) << "prey was not part of the previous level";
+                    const auto prey = found->second;
+                    EXPECT_TRUE(allowedToTake[prey]) << "prey " << prey;
+                    for (const auto index : lodTetrahedron.tetrahedron.indices)
+                        EXPECT_FALSE(onSurface(verticesBefore[index])) << "prey " << prey << " touches the boundary";
+                    const auto claim = [&](TetIndex tetrahedron) {
+                        EXPECT_EQ(owner[tetrahedron], std::numeric_limits<TetIndex>::max()) << "preys " << owner[tetrahedron]
+                            << " and " << prey << " meet at " << tetrahedron;
+                        owner[tetrahedron] = prey;
+                    };
+                    claim(prey);
+                    for (const auto& [connecting, type] : before[prey])
+                        claim(connecting);
+                }
+                previous = std::move(level);
+            }
+        }
+}
+
+// The chain generates the same levels as stepping through them with the given heuristic and selection
+TEST(LOD, ChainFollowsHeuristicAndSelection) {
+    const auto mesh = gridMesh(6);
+    for (const auto heuristic : { Heuristic::Random, Heuristic::VolumeError })
+        for (const auto selection : { PreySelection::Greedy, PreySelection::IndependentSet })
+        {
+            SCOPED_TRACE("heuristic " + std::to_string((int)heuristic) + ", selection " + std::to_string((int)selection));
+            LODWorkspace chainWorkspace;
+            chainWorkspace.incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+            auto chainGraph = buildTetGraph(mesh.tetrahedrons, chainWorkspace.incidence);
+            const auto allowedToTake = findCollapsible(chainGraph);
+            const auto chain = generateLODChain(mesh, chainGraph, chainWorkspace, allowedToTake, "grid", heuristic, selection);
+
+            LODWorkspace workspace;
+            workspace.incidence = buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size());
+            auto graph = buildTetGraph(mesh.tetrahedrons, workspace.incidence);
+            auto vertices = mesh.vertices;
+            auto tetrahedrons = mesh.tetrahedrons;
+            CollapseQueue collapseQueue;
+            auto previous = defaultLODLevel(graph);
+            for (size_t i = 1; i < LOD_COUNT; i++)
+            {
+                LODGenerateInfo generateInfo{ previous.usageAfter, allowedToTake, previous.lodTetrahedrons, graph, workspace,
+                    (LodLevelFlag)i, heuristic, "grid", selection, &collapseQueue };
+                auto level = loadLODLevel(generateInfo, vertices, tetrahedrons);
+                EXPECT_EQ(level.usageAfter, chain[i].usageAfter) << "level " << i;
+                ASSERT_EQ(level.lodTetrahedrons.size(), chain[i].lodTetrahedrons.size()) << "level " << i;
+                for (size_t j = 0; j < level.lodTetrahedrons.size(); j++)
+                    EXPECT_EQ(std::to_array(level.lodTetrahedrons[j].tetrahedron.indices),
+                        std::to_array(chain[i].lodTetrahedrons[j].tetrahedron.indices)) << "level " << i;
+                previous = std::move(level);
+            }
+        }
+}
+
+// The out of core adjacency of the streaming loader, fed chunk by chunk and spilled into many sort runs, against
+// the in memory face neighbours
+TEST(OutOfCore, FaceAdjacencyMatchesReference) {
+    const TemporaryDirectory directory;
+    const auto mesh = gridMesh(4);
+    const auto file = (directory.path / "grid.vtk").string();
+    writeLegacyVTK(file, mesh, true);
+
+    const size_t budget = 64 * sizeof(FaceRecord);
+    ExternalSorter<FaceRecord> faces(directory.path, budget);
+    MeshChunkReader reader(file);
+    ASSERT_EQ(reader.vertexAmount, mesh.vertices.size());
+    ASSERT_EQ(reader.tetrahedronAmount, mesh.tetrahedrons.size());
+    MeshData chunk;
+    MeshData read;
+    while (reader.next(chunk, 100))
+    {
+        for (size_t i = 0; i < chunk.tetrahedrons.size(); i++)
+            pushFaces(faces, chunk.tetrahedrons[i], (TetIndex)(read.tetrahedrons.size() + i));
+        read.vertices.insert(read.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        read.tetrahedrons.insert(read.tetrahedrons.end(), chunk.tetrahedrons.begin(), chunk.tetrahedrons.end());
+    }
+    expectSameMesh(mesh, read);
+    EXPECT_GT(faces.runs.size(), 1u);
+
+    const auto adjacencyFile = (directory.path / "grid.adjacency").string();
+    const auto boundaryFaces = writeFaceAdjacency(faces, mesh.tetrahedrons.size(), adjacencyFile, directory.path, budget);
+    // Two triangles on every cube face of the surface
+    EXPECT_EQ(boundaryFaces, 6u * 4 * 4 * 2);
+    ASSERT_EQ(std::filesystem::file_size(adjacencyFile), mesh.tetrahedrons.size() * sizeof(std::array<TetIndex, 4>));
+    std::vector<std::array<TetIndex, 4>> adjacency(mesh.tetrahedrons.size());
+    std::ifstream(adjacencyFile, std::ios::binary).read((char*)adjacency.data(), adjacency.size() * sizeof(adjacency[0]));
+    auto expected = buildFaceNeighbours(mesh.tetrahedrons, buildVertexIncidence(mesh.tetrahedrons, mesh.vertices.size()));
+    for (TetIndex i = 0; i < mesh.tetrahedrons.size(); i++)
+    {
+        // Rows of the adjacency file are sorted, the ones of buildFaceNeighbours follow the faces
+        std::ranges::sort(expected[i]);
+        EXPECT_EQ(adjacency[i], expected[i]) << "tetrahedron " << i;
+    }
+}
@@ -0,0 +1,93 @@
+#include "Util.hpp"
+#include "MeshCore.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Writes the .tetbin cache of every mesh in a directory, the viewer then only maps and uploads it.
+// Usage: MeshPreprocess <directory> [--recursive] [--force] [--jobs N]
+
+inline bool isMeshFile(const std::filesystem::path& file) {
+    const auto extension = file.extension();
+    return extension == ".vtk" || extension == ".tet";
+}
+
+int main(int argc, char** argv) {
+    std::string directory;
+    bool recursive = false;
+    bool force = false;
+    size_t jobs = amountOfWorkers();
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+        if (argument == "--recursive") recursive = true;
+        else if (argument == "--force") force = true;
+        else if (argument == "--jobs" && i + 1 < argc) jobs = std::max<size_t>(1, std::stoull(argv[++i]));
+        else directory = argument;
+    }
+    if (directory.empty() || !std::filesystem::is_directory(directory)) {
+        std::cerr << "Usage: MeshPreprocess <directory> [--recursive] [--force] [--jobs N]" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> files;
+    const auto collect = [&](const auto& iterator) {
+        for (const auto& entry : iterator)
+            if (entry.is_regular_file() && isMeshFile(entry.path())) files.push_back(entry.path().string());
+    };
+    if (recursive) collect(std::filesystem::recursive_directory_iterator(directory));
+    else collect(std::filesystem::directory_iterator(directory));
+    std::ranges::sort(files);
+
+    // Every job takes the next mesh, lower --jobs for huge meshes to bound the memory in use at once
+    const auto startTime = std::chrono::steady_clock::now();
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> generated = 0;
+    std::atomic<size_t> failed = 0;
+    std::mutex outputMutex;
+    const auto work = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++)
+        {
+            const auto& file = files[i];
+            try {
+                const auto header = meshCacheHeader(file);
+                if (!force && openMeshCache(file, header)) {
+                    const std::lock_guard lock(outputMutex);
+                    std::cout << "Up to date " << file << std::endl;
+                    continue;
+                }
+                const auto startTimeMesh = std::chrono::steady_clock::now();
+                MeshLayout layout;
+                generateMeshCache(file, header, layout);
+                const auto durationMesh = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTimeMesh);
+                generated++;
+                const std::lock_guard lock(outputMutex);
+                std::cout << "Preprocessing time " << durationMesh.count() / (1e6f) << " ms for " << file << " ("
+                    << layout.totalSize() / (1024.0f * 1024.0f) << " MiB)" << std::endl;
+            }
+            catch (const std::exception& exception) {
+                failed++;
+                const std::lock_guard lock(outputMutex);
+                std::cerr << "Warning: Could not preprocess " << file << ": " << exception.what() << std::endl;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(jobs, files.size()); i++)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker : workers)
+        worker.join();
+
+    const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+    std::cout << "Preprocessed " << generated << " of " << files.size() << " meshes in " << duration.count() / (1e6f) << " ms";
+    if (failed) std::cout << ", " << failed << " failed";
+    std::cout << std::endl;
+    return failed ? -1 : 0;
+}
@@ -4,6 +4,25 @@
 #include <array>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 template<std::invocable F>
 struct ScopeExit {
@@ -22,3 +41,95 @@ inline std::vector<char> readFullFile(const std::string& name) {
     fileStream.read(values.data(), fileSize);
     return values;
 }
+
+// Read only view of a whole file, the pages are loaded lazily by the OS
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+
+    MappedFile(const std::string& name) {
+        file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not find file!");
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            throw std::runtime_error("Could not map file!");
+        }
+    }
+
+    ~MappedFile() {
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+    }
+#else
+    int file = -1;
+
+    MappedFile(const std::string& name) {
+        file = open(name.c_str(), O_RDONLY);
+        if (file < 0) throw std::runtime_error("Could not find file!");
+        struct stat fileStat;
+        fstat(file, &fileStat);
+        size = (size_t)fileStat.st_size;
+        if (size == 0) return;
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Could not map file!");
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const char*)mapped;
+    }
+
+    ~MappedFile() {
+        if (data) munmap((void*)data, size);
+        close(file);
+    }
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+inline size_t amountOfWorkers() {
+    return std::max<size_t>(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, amount) into one contiguous range per worker, calls function(worker, begin, end)
+// and rethrows the first exception of any worker after all of them joined
+template<typename F>
+inline void parallelFor(size_t amount, F&& function) {
+    const size_t workers = std::min(amountOfWorkers(), amount);
+    if (workers <= 1) {
+        if (amount != 0) function(0, 0, amount);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(workers);
+    const auto run = [&](size_t worker) {
+        try {
+            function(worker, amount * worker / workers, amount * (worker + 1) / workers);
+        }
+        catch (...) {
+            errors[worker] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t worker = 1; worker < workers; worker++)
+        threads.emplace_back(run, worker);
+    run(0);
+    for (auto& thread : threads)
+        thread.join();
+    for (const auto& error : errors)
+        if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,168 @@
+// Arrays of one model. By default they are bound as descriptors of set 0 and 1, built with PACKED_MODEL the whole
+// model lives in one buffer and its ModelHeader is reached through the address in the push constants.
+// Include before any other declaration, the shader only uses the macros at the end
+#ifdef PACKED_MODEL
+#extension GL_EXT_buffer_reference : require
+#endif
+
+// Same as LOD_COUNT in MeshCore.hpp
+#define LOD_COUNT 8
+
+struct LODInfo {
+    vec4 previous[4];
+    vec4 next;
+    uvec4 tetrahedron;
+};
+
+struct LODLevelChange {
+    uint indexInTet;
+    uint oldIndex;
+    uint newIndex;
+    uint tetrahedronID;
+};
+
+// Same layout as ClusterBounds in MeshCore.hpp
+struct ClusterBounds {
+    vec4 lower;
+    vec4 upper;
+};
+
+// Written by the projection prepass every frame, same layout as Silhouette in LoadVTK.hpp. area is the screen space
+// min xy and max xy, outline the packed result of outline() in silhouette.glsl
+struct Silhouette {
+    vec4 area;
+    vec2 depth;
+    uint outline;
+    uint padding;
+};
+
+#ifdef PACKED_MODEL
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer IndexArray {
+    uvec4 data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer VertexArray {
+    vec4 data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer UintArray {
+    uint data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer LODArray {
+    LODInfo data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer ChangeArray {
+    LODLevelChange data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer SilhouetteArray {
+    Silhouette data[];
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer BoundsArray {
+    ClusterBounds data[];
+};
+
+// Same layout as ModelHeader in LoadVTK.hpp
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer ModelHeader {
+    VertexArray vertices;
+    IndexArray indices;
+    UintArray sortIndices;
+    UintArray visibility[LOD_COUNT];
+    LODArray collapses[LOD_COUNT];
+    ChangeArray changes[LOD_COUNT];
+    IndexArray faces;
+    BoundsArray clusterBounds;
+    UintArray clusters;
+    VertexArray screenVertices;
+    SilhouetteArray silhouettes;
+    UintArray clusterVisibility;
+    uint tetrahedronAmount;
+    uint vertexAmount;
+    uint clusterAmount;
+};
+
+// Same layout as ModelPushConstants in Context.hpp
+layout(push_constant) uniform PushConstants {
+    ModelHeader model;
+    uint level;
+    uint k;
+    uint j;
+    uvec2 scratch;
+};
+
+#define INDICES model.indices.data
+#define VERTICES model.vertices.data
+#define SORT_INDICES model.sortIndices.data
+#define SORT_AMOUNT model.tetrahedronAmount
+#define VISIBILITY model.visibility[level].data
+#define COLLAPSES model.collapses[level].data
+#define CHANGES model.changes[level].data
+#define FACES model.faces.data
+#define SCREEN_VERTICES model.screenVertices.data
+#define SILHOUETTES model.silhouettes.data
+#define VERTEX_AMOUNT model.vertexAmount
+#define CLUSTER_BOUNDS model.clusterBounds.data
+#define CLUSTERS model.clusters.data
+#define CLUSTER_VISIBILITY model.clusterVisibility.data
+#define CLUSTER_AMOUNT model.clusterAmount
+#else
+layout(binding=1) buffer Index {
+    uvec4 data[];
+} modelIndices;
+layout(binding=2) buffer Vertex {
+    vec4 data[];
+} modelVertices;
+layout(binding=3) buffer SortIndex {
+    uint data[];
+} modelSortIndices;
+layout(set=1, binding=0) buffer LOD {
+    LODInfo data[];
+} modelCollapses;
+layout(set=1, binding=1) buffer Visibility {
+    uint data[];
+} modelVisibility;
+layout(set=1, binding=2) buffer LODChange {
+    LODLevelChange data[];
+} modelChanges;
+layout(binding=4) buffer ScreenVertex {
+    vec4 data[];
+} modelScreenVertices;
+layout(binding=5) buffer SilhouetteData {
+    Silhouette data[];
+} modelSilhouettes;
+layout(binding=6) buffer ClusterBound {
+    ClusterBounds data[];
+} modelClusterBounds;
+layout(binding=7) buffer Cluster {
+    uint data[];
+} modelClusters;
+layout(binding=8) buffer ClusterVisible {
+    uint data[];
+} modelClusterVisibility;
+// Not in the descriptor set layout, only declared so every shader builds in both modes. Its users need PACKED_MODEL
+layout(binding=9) buffer Face {
+    uvec4 data[];
+} modelFaces;
+
+// Same layout as ModelPushConstants in Context.hpp, model and level are unused here
+layout(push_constant) uniform PushConstants {
+    uvec2 model;
+    uint level;
+    uint k;
+    uint j;
+    uvec2 scratch;
+};
+
+#define INDICES modelIndices.data
+#define VERTICES modelVertices.data
+#define SORT_INDICES modelSortIndices.data
+#define SORT_AMOUNT modelSortIndices.data.length()
+#define VISIBILITY modelVisibility.data
+#define COLLAPSES modelCollapses.data
+#define CHANGES modelChanges.data
+#define FACES modelFaces.data
+#define SCREEN_VERTICES modelScreenVertices.data
+#define SILHOUETTES modelSilhouettes.data
+#define VERTEX_AMOUNT modelVertices.data.length()
+#define CLUSTER_BOUNDS modelClusterBounds.data
+#define CLUSTERS modelClusters.data
+#define CLUSTER_VISIBILITY modelClusterVisibility.data
+#define CLUSTER_AMOUNT modelClusterBounds.data.length()
+#endif
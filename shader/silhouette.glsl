@@ -0,0 +1,127 @@
+// Screen space outline of a projected tetrahedron, shared by the sort and the projection prepass. Include after
+// model.glsl, the prepass caches the outline packed into a Silhouette
+
+float aboveLine(vec2 l1, vec2 l2, vec2 p) {
+    vec2 Md = l2 - l1;
+    vec2 n = vec2(Md.y, -Md.x);
+    vec2 dir = l1 - p;
+    return dot(normalize(n), dir);
+}
+
+float distToLine(vec2 l1, vec2 l2, vec2 p) {
+    return abs(aboveLine(l1, l2, p));
+}
+
+uint[5] sortPoints(vec3[4] screenSpace, uint mostLeft, uint mostRight) {
+    uint[5] values;
+    float distanceToLine = 0;
+    uint mostDistantOne = 4;
+    uint otherDist = 4;
+    for(uint x = 0; x < 4; x++) {
+        if(mostRight == x || mostLeft == x) {
+            continue;
+        }
+        float dist = distToLine(screenSpace[mostLeft].xy, screenSpace[mostRight].xy, screenSpace[x].xy);
+        if(dist > distanceToLine) {
+            distanceToLine = dist;
+            mostDistantOne = x;
+            if(otherDist == 4)
+                otherDist = mostDistantOne;
+        } else {
+            otherDist = x;
+        }
+    }
+
+    vec2 P2 = screenSpace[mostDistantOne].xy;
+    vec2 dP0 = screenSpace[mostLeft].xy - P2;
+    vec2 dP1 = screenSpace[mostRight].xy - P2;
+    vec2 dP3 = screenSpace[otherDist].xy - P2;
+    float faktor = dP0.y * dP1.x - dP0.x * dP1.y;
+    // Multiply inverse
+    vec2 lambdas = vec2(dP1.x * dP3.y - dP1.y * dP3.x, dP0.y * dP3.x - dP0.x * dP3.y) / faktor;
+    float lambda2 = 1.0f - lambdas.y - lambdas.x;
+    if(lambdas.x <= 0.0f || lambdas.y <= 0.0f || lambda2 <= 0.0f) {
+        // Case 2
+        float p2Dist = aboveLine(screenSpace[mostLeft].xy, screenSpace[mostRight].xy, P2);
+        float p3Dist = aboveLine(screenSpace[mostLeft].xy, screenSpace[mostRight].xy, screenSpace[otherDist].xy);
+
+        if(sign(p2Dist) != sign(p3Dist)) {
+            // Case: Line is bisecting the quad
+            values[0] = mostLeft;
+            values[1] = otherDist;
+            values[2] = mostRight;
+            values[3] = mostDistantOne;
+            // 4 points on edge
+            values[4] = 4;
+            return values;
+        } 
+        // Case: We need to find the bisection point
+        vec2 baseline = normalize(screenSpace[mostRight].xy - screenSpace[mostLeft].xy);
+        
+        float w1 = dot(baseline, normalize(screenSpace[mostRight].xy - screenSpace[otherDist].xy));
+        float w2 = dot(baseline, normalize(screenSpace[mostRight].xy - screenSpace[mostDistantOne].xy));
+
+        values[0] = mostLeft;
+        values[1] = otherDist;
+        values[3] = mostDistantOne;
+        values[2] = mostRight;
+        if(w1 < w2) {
+            values[1] = mostDistantOne;
+            values[3] = otherDist;
+        }
+        // 4 points on edge
+        values[4] = 4;
+        return values;
+    }
+    // Case: We have a triangle
+    values[0] = mostLeft;
+    values[1] = mostRight;
+    values[2] = mostDistantOne;
+    values[3] = otherDist;
+    // 4 points on edge
+    values[4] = 3;
+    return values;
+}
+
+uint[5] outline(vec3 screenSpace[4]) {
+    uint left = 0, right = 0;
+    for(uint i = 1; i < 4; i++) {
+        if(screenSpace[left].x > screenSpace[i].x)
+            left = i;
+        if(screenSpace[right].x < screenSpace[i].x)
+            right = i;
+    }
+    return sortPoints(screenSpace, left, right);
+}
+
+// Corner indices in 2 bits each, the ninth bit is set for a quad
+uint packOutline(uint[5] values) {
+    return values[0] | (values[1] << 2) | (values[2] << 4) | (values[3] << 6) | (values[4] == 4 ? 1u << 8 : 0u);
+}
+
+uint[5] unpackOutline(uint packed) {
+    uint[5] values;
+    for(uint i = 0; i < 4; i++)
+        values[i] = (packed >> (2 * i)) & 3u;
+    values[4] = (packed & (1u << 8)) != 0 ? 4 : 3;
+    return values;
+}
+
+// Min xy and max xy of the projected corners
+vec4 screenArea(vec3 screenSpace[4]) {
+    vec4 area = vec4(screenSpace[0].xy, screenSpace[0].xy);
+    for(uint i = 1; i < 4; i++)
+        area = vec4(min(area.xy, screenSpace[i].xy), max(area.zw, screenSpace[i].xy));
+    return area;
+}
+
+vec2 depthRange(vec3 screenSpace[4]) {
+    vec2 depth = vec2(screenSpace[0].z);
+    for(uint i = 1; i < 4; i++)
+        depth = vec2(min(depth.x, screenSpace[i].z), max(depth.y, screenSpace[i].z));
+    return depth;
+}
+
+bool overlaps(vec4 area1, vec4 area2) {
+    return all(lessThanEqual(area1.xy, area2.zw)) && all(lessThanEqual(area2.xy, area1.zw));
+}
@@ -1,19 +1,15 @@
 #version 460
 
+#include "model.glsl"
+
 layout (binding=0) uniform Camera {
     mat4 mvp;
 } camera;
-layout (binding=1) buffer Index {
-    readonly uvec4 data[];
-} index;
-layout (binding=2) buffer Vertex {
-    readonly vec4 vertexData[];
-} vertex;
 
 void main() {
     const uint tetraID = gl_VertexIndex / 12;
-    const uvec4 tetrahedron = index.data[tetraID];
+    const uvec4 tetrahedron = INDICES[tetraID];
     const uint vertexID = gl_VertexIndex % 12;
     const uint nextID = vertexID - (vertexID / 2);
-    gl_Position = vertex.vertexData[tetrahedron[nextID]] * camera.mvp;
+    gl_Position = VERTICES[tetrahedron[nextID]] * camera.mvp;
 }